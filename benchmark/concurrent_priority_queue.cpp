@@ -0,0 +1,62 @@
+/**
+ * push/pop throughput of concurrent_priority_queue against one priority_queue
+ * behind a global mutex, for 1 up to the given number of threads
+ * usage: concurrent_priority_queue [max_threads] [operations_per_thread]
+ * prints one "queue,threads,operations,seconds" line per run
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../concurrent_priority_queue.hpp"
+
+struct locked_queue {
+	std::mutex lock;
+	sjtu::priority_queue<int> heap;
+	void push(int x) {
+		std::lock_guard<std::mutex> guard(lock);
+		heap.push(x);
+	}
+	bool try_pop(int &x) {
+		std::lock_guard<std::mutex> guard(lock);
+		if(heap.empty()) return false;
+		x = heap.top();
+		heap.pop();
+		return true;
+	}
+};
+
+// every thread alternates a push with a pop on a queue prefilled with 2^16 elements
+template<class Queue>
+static double run(Queue &q, size_t threads, size_t operations) {
+	for(unsigned i = 0; i < 65536; ++i) q.push((int)(i * 40503u % 65536));
+	std::vector<std::thread> workers;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(size_t t = 0; t < threads; ++t) workers.push_back(std::thread([&q, operations, t] {
+		int x = 0;
+		for(size_t i = 0; i < operations; ++i) {
+			q.push((int)(i * 2654435761u % 1000000 + t));
+			q.try_pop(x);
+		}
+	}));
+	for(size_t t = 0; t < threads; ++t) workers[t].join();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+	size_t max_threads = argc > 1 ? strtoul(argv[1], NULL, 10) : std::thread::hardware_concurrency();
+	size_t operations = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+	if(max_threads == 0) max_threads = 1;
+	printf("queue,threads,operations,seconds\n");
+	for(size_t threads = 1; threads <= max_threads; threads *= 2) {
+		locked_queue locked;
+		printf("mutex,%zu,%zu,%.6f\n", threads, threads * operations, run(locked, threads, operations));
+		sjtu::concurrent_priority_queue<int> relaxed;
+		printf("relaxed,%zu,%zu,%.6f\n", threads, threads * operations, run(relaxed, threads, operations));
+		sjtu::concurrent_priority_queue<int> strict(0, sjtu::concurrent_priority_queue<int>::strict);
+		printf("strict,%zu,%zu,%.6f\n", threads, threads * operations, run(strict, threads, operations));
+	}
+	return 0;
+}
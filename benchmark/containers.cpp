@@ -0,0 +1,269 @@
+/**
+ * sjtu::deque, map, unordered_map and priority_queue against their std counterparts
+ * for int, Diamond::Matrix<double> and Util::Bint elements (headers from dataset.zip),
+ * sizes 1e3, 1e4, ... up to max_n; a payload type stops at its own limit,
+ * Bint allocates 8KB per object
+ * usage: containers [max_n] [container]
+ * prints one "container,impl,type,workload,n,seconds,bytes,overhead_per_element" line per run;
+ * timed runs leave the memory columns empty, the "memory" rows of the sjtu containers
+ * (from memory_usage() once every element is in) leave seconds empty
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include "class-bint.hpp"
+#include "class-matrix.hpp"
+#include "../deque.hpp"
+#include "../map.hpp"
+#include "../priority_queue.hpp"
+#include "../unordered_map.hpp"
+
+typedef Diamond::Matrix<double> matrix;
+
+// make(x) is only called with x < range, digest(value, range) condenses a value into a checksum term
+template<class T> struct payload;
+template<> struct payload<int> {
+	static const char *name() {return "int";}
+	static size_t limit() {return 10000000;}
+	static int make(unsigned x) {return (int)x;}
+	static size_t digest(const int &x, size_t) {return x;}
+};
+template<> struct payload<matrix> {
+	static const char *name() {return "class-matrix";}
+	static size_t limit() {return 1000000;}
+	static matrix make(unsigned x) {return matrix(2, 2, x);}
+	static size_t digest(const matrix &x, size_t) {return (size_t)x[0][0];}
+};
+template<> struct payload<Util::Bint> {
+	static const char *name() {return "class-bint";}
+	static size_t limit() {return 10000;}
+	static Util::Bint make(unsigned x) {return Util::Bint((long long)x);}
+	// Bint shows no digits, the value is placed among 15 cuts spread evenly over [0, range);
+	// the cuts are made once per range, a lookup is four comparisons
+	static size_t digest(const Util::Bint &x, size_t range) {
+		static size_t cut_range = 0;
+		static std::vector<Util::Bint> cuts;
+		if(range != cut_range) {
+			cuts.clear();
+			for(size_t k = 1; k < 16; ++k) cuts.push_back(make((unsigned)(range / 16 * k)));
+			cut_range = range;
+		}
+		size_t low = 0, high = cuts.size();
+		while(low < high) {
+			size_t mid = (low + high) / 2;
+			if(x < cuts[mid]) high = mid;
+			else low = mid + 1;
+		}
+		return low;
+	}
+};
+
+static unsigned long long seed;
+// next_random() < RANDOM_RANGE
+static const size_t RANDOM_RANGE = (size_t)1 << 31;
+static unsigned next_random() {
+	seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (unsigned)(seed >> 33);
+}
+static volatile size_t sink;
+
+// lookups and edits in the middle are sampled, a full pass would be quadratic for deque;
+// std::deque shifts O(n) elements per edit, so large sizes get fewer of them
+static size_t probes(size_t n) {return n < 100000 ? n : 100000;}
+static size_t edits(size_t n) {return n <= 100000 ? (n < 2000 ? n : 2000) : 200000000 / n;}
+
+class stopwatch {
+	const char *container, *impl, *type;
+	size_t n;
+	std::chrono::steady_clock::time_point start;
+public:
+	stopwatch(const char *_container, const char *_impl, const char *_type, size_t _n) :
+		container(_container), impl(_impl), type(_type), n(_n) {}
+	void reset() {
+		seed = 19260817;
+		start = std::chrono::steady_clock::now();
+	}
+	void report(const char *workload) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("%s,%s,%s,%s,%zu,%.6f,,\n", container, impl, type, workload, n, seconds);
+		fflush(stdout);
+		reset();
+	}
+	void report(const sjtu::memory_footprint &memory) {
+		printf("%s,%s,%s,memory,%zu,,%zu,%.2f\n", container, impl, type, n, memory.bytes, memory.overhead_per_element);
+		fflush(stdout);
+		reset();
+	}
+};
+
+// std containers cannot report their memory, they get no memory row
+template<class Container>
+static void measure(stopwatch &clock, const Container &) {clock.reset();}
+template<class T>
+static void measure(stopwatch &clock, const sjtu::deque<T> &d) {clock.report(d.memory_usage());}
+template<class Key, class T>
+static void measure(stopwatch &clock, const sjtu::map<Key, T> &m) {clock.report(m.memory_usage());}
+template<class Key, class T>
+static void measure(stopwatch &clock, const sjtu::unordered_map<Key, T> &m) {clock.report(m.memory_usage());}
+template<class T>
+static void measure(stopwatch &clock, const sjtu::priority_queue<T> &q) {clock.report(q.memory_usage());}
+
+template<class Deque, class T>
+static void deque_suite(const char *impl, size_t n) {
+	typedef payload<T> P;
+	stopwatch clock("deque", impl, P::name(), n);
+	size_t check = 0;
+	clock.reset();
+	{
+		Deque d;
+		for(size_t i = 0; i < n; ++i) {
+			if(i & 1) d.push_back(P::make(i));
+			else d.push_front(P::make(i));
+		}
+		while(!d.empty()) check += P::digest(d.front(), n), d.pop_front();
+	}
+	clock.report("push_pop");
+	Deque d;
+	for(size_t i = 0; i < n; ++i) d.push_back(P::make(i));
+	measure(clock, d);
+	for(size_t i = probes(n); i > 0; --i) check += P::digest(d[next_random() % n], n);
+	clock.report("random_access");
+	for(typename Deque::iterator it = d.begin(); it != d.end(); ++it) check += P::digest(*it, n);
+	clock.report("iterate");
+	for(size_t i = edits(n); i > 0; --i) {
+		d.insert(d.begin() + next_random() % d.size(), P::make(i));
+		d.erase(d.begin() + next_random() % d.size());
+	}
+	clock.report("insert_erase");
+	{
+		Deque copy(d);
+		check += copy.size();
+	}
+	clock.report("copy");
+	sink = check;
+}
+
+// the keys of one batch are looked up together where the map can overlap them
+template<class Map>
+static size_t count_all(const Map &m, const int *keys, size_t n) {
+	size_t rtn = 0;
+	for(size_t i = 0; i < n; ++i) rtn += m.count(keys[i]);
+	return rtn;
+}
+template<class T>
+static size_t count_all(const sjtu::map<int, T> &m, const int *keys, size_t n) {return m.count_batch(keys, n);}
+
+// unordered maps run the same workloads under their own name
+template<class Map, class T>
+static void map_suite(const char *impl, size_t n, const char *container = "map") {
+	typedef payload<T> P;
+	typedef typename Map::value_type value_type;
+	stopwatch clock(container, impl, P::name(), n);
+	size_t check = 0;
+	std::vector<int> keys(n);
+	for(size_t i = 0; i < n; ++i) keys[i] = 2 * (int)i;
+	seed = 19260817;
+	for(size_t i = n; i > 1; --i) std::swap(keys[i - 1], keys[next_random() % i]);
+	Map m;
+	clock.reset();
+	for(size_t i = 0; i < n; ++i) m.insert(value_type(keys[i], P::make(i)));
+	clock.report("insert");
+	measure(clock, m);
+	for(size_t i = probes(n); i > 0; --i) check += P::digest(m.find(keys[next_random() % n])->second, n);
+	clock.report("lookup_hit");
+	for(size_t i = probes(n); i > 0; --i) check += m.count(2 * (int)(next_random() % n) + 1);
+	clock.report("lookup_miss");
+	int batch[64];
+	for(size_t i = probes(n) / 64; i > 0; --i) {
+		for(size_t j = 0; j < 64; ++j) batch[j] = keys[next_random() % n];
+		check += count_all(m, batch, 64);
+	}
+	clock.report("lookup_batch");
+	for(typename Map::iterator it = m.begin(); it != m.end(); ++it) check += P::digest(it->second, n);
+	clock.report("iterate");
+	for(size_t i = probes(n); i > 0; --i) {
+		int key = keys[next_random() % n];
+		m.erase(m.find(key));
+		m.insert(value_type(key, P::make(i)));
+	}
+	clock.report("insert_erase");
+	{
+		Map copy(m);
+		check += copy.size();
+	}
+	clock.report("copy");
+	sink = check;
+}
+
+template<class Queue, class T>
+static void priority_queue_suite(const char *impl, size_t n) {
+	typedef payload<T> P;
+	stopwatch clock("priority_queue", impl, P::name(), n);
+	size_t check = 0;
+	Queue q;
+	clock.reset();
+	for(size_t i = 0; i < n; ++i) q.push(P::make(next_random()));
+	clock.report("push");
+	measure(clock, q);
+	for(size_t i = probes(n); i > 0; --i) {
+		check += P::digest(q.top(), RANDOM_RANGE);
+		q.pop();
+		q.push(P::make(next_random()));
+	}
+	clock.report("pop_push");
+	{
+		Queue copy(q);
+		check += copy.size();
+	}
+	clock.report("copy");
+	while(!q.empty()) check += P::digest(q.top(), RANDOM_RANGE), q.pop();
+	clock.report("pop");
+	sink = check;
+}
+
+template<class T>
+static void run(const char *container, size_t max_n) {
+	for(size_t n = 1000; n <= max_n && n <= payload<T>::limit(); n *= 10) {
+		if(!strcmp(container, "all") || !strcmp(container, "deque")) {
+			deque_suite<std::deque<T>, T>("std", n);
+			deque_suite<sjtu::deque<T>, T>("sjtu", n);
+		}
+		if(!strcmp(container, "all") || !strcmp(container, "map")) {
+			map_suite<std::map<int, T>, T>("std", n);
+			map_suite<sjtu::map<int, T>, T>("sjtu", n);
+		}
+		if(!strcmp(container, "all") || !strcmp(container, "unordered_map")) {
+			map_suite<std::unordered_map<int, T>, T>("std", n, "unordered_map");
+			map_suite<sjtu::unordered_map<int, T>, T>("sjtu", n, "unordered_map");
+		}
+	}
+}
+
+// matrix has no ordering, so it is not queued
+template<class T>
+static void run_queues(const char *container, size_t max_n) {
+	if(strcmp(container, "all") && strcmp(container, "priority_queue")) return;
+	for(size_t n = 1000; n <= max_n && n <= payload<T>::limit(); n *= 10) {
+		priority_queue_suite<std::priority_queue<T>, T>("std", n);
+		priority_queue_suite<sjtu::priority_queue<T>, T>("sjtu", n);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	size_t max_n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+	const char *container = argc > 2 ? argv[2] : "all";
+	printf("container,impl,type,workload,n,seconds,bytes,overhead_per_element\n");
+	run<int>(container, max_n);
+	run_queues<int>(container, max_n);
+	run<matrix>(container, max_n);
+	run<Util::Bint>(container, max_n);
+	run_queues<Util::Bint>(container, max_n);
+	return 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * push/pop throughput of every priority_queue engine against std::priority_queue
+ * on monotone integer workloads, the only ones the radix heap accepts
+ * usage: priority_queue_engines [n]
+ * prints one "engine,workload,n,seconds,checksum" line per run; the checksum keeps the
+ * popped keys alive and has to agree between the engines of a workload
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <vector>
+#include "../priority_queue.hpp"
+
+typedef unsigned key_type;
+typedef std::greater<key_type> compare_type;
+
+struct std_engine {};
+
+template<class Engine>
+struct queue_of {
+	typedef sjtu::priority_queue<key_type, compare_type, Engine> type;
+};
+template<>
+struct queue_of<std_engine> {
+	typedef std::priority_queue<key_type, std::vector<key_type>, compare_type> type;
+};
+
+static unsigned long long seed = 19260817;
+static key_type next_random() {
+	seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (key_type)(seed >> 33);
+}
+
+// n pending events, each pop schedules a new one a random delay later
+template<class Queue>
+static key_type hold(size_t n) {
+	Queue q;
+	key_type check = 0;
+	for(size_t i = 0; i < n; ++i) q.push(next_random() % 1024);
+	for(size_t i = 0; i < 4 * n; ++i) {
+		key_type now = q.top();
+		q.pop();
+		check ^= now;
+		q.push(now + next_random() % 1024);
+	}
+	return check;
+}
+
+// push everything, then pop everything
+template<class Queue>
+static key_type sort(size_t n) {
+	Queue q;
+	key_type check = 0;
+	for(size_t i = 0; i < n; ++i) q.push(next_random());
+	while(!q.empty()) check ^= q.top(), q.pop();
+	return check;
+}
+
+template<class Engine>
+static void run(const char *engine, size_t n) {
+	typedef typename queue_of<Engine>::type queue_type;
+	const char *names[] = {"hold", "sort"};
+	key_type (*workloads[])(size_t) = {hold<queue_type>, sort<queue_type>};
+	for(int i = 0; i < 2; ++i) {
+		seed = 19260817;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		key_type check = workloads[i](n);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("%s,%s,%zu,%.6f,%u\n", engine, names[i], n, seconds, check);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+	printf("engine,workload,n,seconds,checksum\n");
+	run<std_engine>("std", n);
+	run<sjtu::leftist_heap>("leftist_heap", n);
+	run<sjtu::pairing_heap>("pairing_heap", n);
+	run<sjtu::dary_heap<4> >("dary_heap<4>", n);
+	run<sjtu::radix_heap>("radix_heap", n);
+	return 0;
+}
@@ -0,0 +1,33 @@
+#!/bin/sh
+# replay the priority_queue-advan-* programs from dataset.zip with every engine
+# that accepts their workloads, check the output and report the run time
+# usage: benchmark/priority_queue_replay.sh [compiler flags...]
+# prints one "engine,test,seconds,result" line per run; the radix heap only
+# takes monotone unsigned keys and is measured by priority_queue_engines instead
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+CXX=${CXX:-g++}
+flags=${*:--O2}
+
+unzip -q -j "$root/dataset.zip" 'priority_queue/priority_queue-advan-*' \
+	'priority_queue/testans-priority_queue-advan-*' -d "$work" || exit 1
+
+echo "engine,test,seconds,result"
+for engine in leftist_heap pairing_heap 'dary_heap<4>'; do
+	for source in "$work"/priority_queue-advan-*.cc; do
+		test=$(basename "$source" .cc)
+		binary="$work/$test"
+		if ! $CXX -std=c++11 $flags -I"$root" "-DSJTU_PRIORITY_QUEUE_ENGINE=$engine" \
+			-o "$binary" "$source" 2> "$binary.log"; then
+			echo "$engine,$test,,compile error"
+			continue
+		fi
+		start=$(date +%s.%N)
+		(cd "$work" && "$binary" > "$binary.out" 2>&1)
+		end=$(date +%s.%N)
+		if diff -q "$binary.out" "$work/testans-$test.txt" > /dev/null; then result=ok; else result=wrong; fi
+		echo "$engine,$test,$(awk "BEGIN {printf \"%.3f\", $end - $start}"),$result"
+	done
+done
@@ -0,0 +1,161 @@
+#ifndef SJTU_CONCURRENT_PRIORITY_QUEUE_HPP
+#define SJTU_CONCURRENT_PRIORITY_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "priority_queue.hpp"
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+/**
+ * a priority queue shared by several threads (link with -pthread)
+ * elements are spread over independently locked shards, each one a priority_queue;
+ * relaxed: push goes to a random shard and pop takes the better top of two random
+ *   shards, so it may return an element ranked up to about O(shards) below the best
+ * strict: pop locks every shard and returns the best element, push stays sharded
+ * merge deals the incoming elements out over all shards, so the bound holds after it too
+ */
+template<typename T, class Compare = std::less<T>, class Engine = SJTU_PRIORITY_QUEUE_ENGINE>
+class concurrent_priority_queue {
+public:
+	typedef priority_queue<T, Compare, Engine> queue_type;
+	enum ordering {strict, relaxed};
+private:
+	struct shard {
+		std::mutex lock;
+		queue_type heap;
+		std::atomic<size_t> size;
+		char padding[64]; // keep neighbouring shards off each other's cache lines
+		shard() : size(0) {}
+	};
+	const static int TRIES = 8;
+	shard *shards;
+	size_t shard_count;
+	ordering order;
+
+	size_t pick() const {
+		thread_local unsigned long long state = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state % shard_count;
+	}
+	// whether x should leave before y, an empty shard never wins
+	static bool better(shard &x, shard &y) {
+		if(x.heap.empty()) return false;
+		if(y.heap.empty()) return true;
+		Compare cmp;
+		return !cmp(x.heap.top(), y.heap.top());
+	}
+	static void take(shard &now, T &out) {
+		out = now.heap.top();
+		now.heap.pop();
+		--now.size;
+	}
+	bool pop_strict(T &out) {
+		for(size_t i = 0; i < shard_count; ++i) shards[i].lock.lock();
+		shard *best = &shards[0];
+		for(size_t i = 1; i < shard_count; ++i) if(better(shards[i], *best)) best = &shards[i];
+		bool rtn = !best->heap.empty();
+		if(rtn) take(*best, out);
+		for(size_t i = shard_count; i-- > 0; ) shards[i].lock.unlock();
+		return rtn;
+	}
+public:
+	// shard_count = 0 picks two shards per hardware thread
+	explicit concurrent_priority_queue(size_t _shard_count = 0, ordering _order = relaxed) : order(_order) {
+		if(_shard_count == 0) _shard_count = 2 * std::thread::hardware_concurrency();
+		shard_count = _shard_count ? _shard_count : 1;
+		shards = new shard[shard_count];
+	}
+	concurrent_priority_queue(const concurrent_priority_queue &other) = delete;
+	concurrent_priority_queue &operator=(const concurrent_priority_queue &other) = delete;
+	~concurrent_priority_queue() {delete [] shards;}
+	void push(const T &e) {
+		for(int attempt = 0; ; ++attempt) {
+			shard &now = shards[pick()];
+			if(attempt < TRIES) {
+				if(!now.lock.try_lock()) continue;
+			} else now.lock.lock();
+			now.heap.push(e);
+			++now.size;
+			now.lock.unlock();
+			return;
+		}
+	}
+	// false only if every shard was found empty
+	bool try_pop(T &out) {
+		if(order == relaxed && shard_count > 1) for(int attempt = 0; attempt < TRIES; ++attempt) {
+			size_t i = pick(), j = pick();
+			if(i == j) j = (i + 1) % shard_count;
+			std::unique_lock<std::mutex> x(shards[i].lock, std::try_to_lock);
+			if(!x.owns_lock()) continue;
+			std::unique_lock<std::mutex> y(shards[j].lock, std::try_to_lock);
+			if(!y.owns_lock()) continue;
+			shard &best = better(shards[j], shards[i]) ? shards[j] : shards[i];
+			if(best.heap.empty()) continue;
+			take(best, out);
+			return true;
+		}
+		return pop_strict(out);
+	}
+	T pop() {
+		T rtn;
+		if(!try_pop(rtn)) throw container_is_empty();
+		return rtn;
+	}
+	// deal other out over the shards in order, every shard gets its share of the best elements;
+	// each share goes in through priority_queue::merge, one shard locked at a time
+	void merge(queue_type &other) {
+		std::vector<queue_type> parts(other.size() < shard_count ? other.size() : shard_count);
+		for(size_t i = 0; !other.empty(); ++i) {
+			parts[i % parts.size()].push(other.top());
+			other.pop();
+		}
+		size_t first = pick();
+		for(size_t i = 0; i < parts.size(); ++i) {
+			shard &now = shards[(first + i) % shard_count];
+			std::lock_guard<std::mutex> guard(now.lock);
+			now.size += parts[i].size();
+			now.heap.merge(parts[i]);
+		}
+	}
+	// move every element into out through priority_queue::merge
+	void collect(queue_type &out) {
+		for(size_t i = 0; i < shard_count; ++i) {
+			std::lock_guard<std::mutex> guard(shards[i].lock);
+			out.merge(shards[i].heap);
+			shards[i].size = 0;
+		}
+	}
+	size_t size() const {
+		size_t rtn = 0;
+		for(size_t i = 0; i < shard_count; ++i) rtn += shards[i].size;
+		return rtn;
+	}
+	bool empty() const {
+		return size() == 0;
+	}
+	// locks one shard at a time, so the total is only exact while no other thread writes
+	memory_footprint memory_usage() const {
+		size_t elements = 0, nodes = 0, bytes = sizeof(concurrent_priority_queue) + shard_count * sizeof(shard);
+		for(size_t i = 0; i < shard_count; ++i) {
+			std::lock_guard<std::mutex> guard(shards[i].lock);
+			memory_footprint now = shards[i].heap.memory_usage();
+			elements += now.elements, nodes += now.nodes;
+			bytes += now.bytes - sizeof(queue_type);
+		}
+		return memory_footprint(elements, sizeof(T), nodes, bytes);
+	}
+	ordering get_ordering() const {return order;}
+	size_t shards_used() const {return shard_count;}
+};
+
+}
+
+#endif
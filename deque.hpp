@@ -2,28 +2,56 @@
 #define SJTU_DEQUE_HPP
 
 #include "exceptions.hpp"
+#include "spill.hpp"
+#include "stats.hpp"
+#include "utility.hpp"
 #include <iostream>
+#include <atomic>
 #include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
 
 namespace sjtu { 
 
 template<typename T>
 class list {
 	
+	// a trivially copyable element lives in its node, anything else in an allocation of its own
+	const static bool INLINE = std::is_trivially_copyable<T>::value;
 	struct node {
 		node *prev, *next;
 		T *data;
-		node(node *_prev = NULL, node *_next = NULL, T *_data = NULL) :
-			prev(_prev), next(_next), data(_data) {
-		}
+		typename std::aligned_storage<INLINE ? sizeof(T) : 1, INLINE ? alignof(T) : 1>::type buffer;
+		node(node *_prev = NULL, node *_next = NULL) : prev(_prev), next(_next), data(NULL) {}
 		~node() {
-			if(data != NULL) delete data;
+			if(data != NULL && !INLINE) delete data;
 		}
 	};
 	
 	size_t current_size;
 	node *head, *tail;
 	
+	template<class V>
+	static T * make(void *buffer, V &&value, std::true_type) {return new(buffer) T(std::forward<V>(value));}
+	template<class V>
+	static T * make(void *, V &&value, std::false_type) {return new T(std::forward<V>(value));}
+	// link a new node holding value in front of pos
+	template<class V>
+	node * link(node *pos, V &&value) {
+		node *rtn = new node(pos->prev, pos);
+		try {
+			rtn->data = make(&rtn->buffer, std::forward<V>(value), std::integral_constant<bool, INLINE>());
+		} catch(...) {
+			delete rtn;
+			throw;
+		}
+		pos->prev->next = rtn;
+		pos->prev = rtn;
+		++current_size;
+		return rtn;
+	}
+	
 public:
 	class const_iterator;
 	class iterator {
@@ -44,7 +72,7 @@ public:
 		}
 		iterator operator-(int n) const {return operator+(-n);}
 		int operator-(const iterator &rhs) const {
-			if(belong != rhs.belong) throw invalid_iterator();
+			SJTU_THROW_IF(belong != rhs.belong, invalid_iterator);
 			return index - rhs.index;
 		}
 		iterator operator+=(const int &n) {return *this = operator+(n);}
@@ -62,7 +90,7 @@ public:
 		}
 		iterator& operator--() {return *this = operator-(1);}
 		T& operator*() const{
-			if(current_node == belong->tail) throw invalid_iterator();
+			SJTU_THROW_IF(current_node == belong->tail, invalid_iterator);
 			return *current_node->data;
 		}
 		T* operator->() const noexcept {return current_node->data;}
@@ -99,7 +127,7 @@ public:
 		}
 		const_iterator operator-(int n) const {return operator+(-n);}
 		int operator-(const const_iterator &rhs) const {
-			if(belong != rhs.belong) throw invalid_iterator();
+			SJTU_THROW_IF(belong != rhs.belong, invalid_iterator);
 			return index - rhs.index;
 		}
 		const_iterator operator+=(const int &n) {return *this = operator+(n);}
@@ -117,7 +145,7 @@ public:
 		}
 		const_iterator& operator--() {return *this = operator-(1);}
 		const T& operator*() const{
-			if(current_node == belong->tail) throw invalid_iterator();
+			SJTU_THROW_IF(current_node == belong->tail, invalid_iterator);
 			return *current_node->data;
 		}
 		const T* operator->() const noexcept {return &(*current_node->data);}
@@ -170,8 +198,17 @@ public:
 		if(pos >= current_size) throw index_out_of_bound();
 		return *(cbegin() + pos);
 	}
-	T & operator[](const size_t &pos) {return at(pos);}
-	const T & operator[](const size_t &pos) const {return at(pos);}
+	T & operator[](const size_t &pos) {
+		SJTU_THROW_IF(pos >= current_size, index_out_of_bound);
+		return *(begin() + pos);
+	}
+	const T & operator[](const size_t &pos) const {
+		SJTU_THROW_IF(pos >= current_size, index_out_of_bound);
+		return *(cbegin() + pos);
+	}
+	// NULL instead of index_out_of_bound
+	T * try_at(const size_t &pos) {return pos < current_size ? &*(begin() + pos) : NULL;}
+	const T * try_at(const size_t &pos) const {return pos < current_size ? &*(cbegin() + pos) : NULL;}
 	const T & front() const {
 		if(empty()) throw container_is_empty();
 		return *cbegin();
@@ -186,19 +223,26 @@ public:
 	const_iterator cend() const {return const_iterator(current_size, tail->prev, this);}
 	bool empty() const {return current_size == 0;}
 	size_t size() const {return current_size;}
-	void clear() {while(!empty()) pop_back();}
-	void push_back(const T &value) {
-		++current_size;
-		node *new_node = new node(tail->prev->prev, tail->prev, new T(value));
-		tail->prev->prev->next = new_node;
-		tail->prev->prev = new_node;
+	// a node per element plus three sentinel nodes, and the elements kept outside their nodes
+	memory_footprint memory_usage() const {
+		size_t nodes = current_size + 3;
+		return memory_footprint(current_size, sizeof(T), nodes,
+			sizeof(list) + nodes * sizeof(node) + (INLINE ? 0 : current_size * sizeof(T)));
 	}
-	void push_back(T &&value) {
-		++current_size;
-		node *new_node = new node(tail->prev->prev, tail->prev, new T(std::move(value)));
-		tail->prev->prev->next = new_node;
-		tail->prev->prev = new_node;
+	// one pass freeing the nodes, nothing is relinked until the end
+	void clear() {
+		node *now = head->next, *last = tail->prev;
+		while(now != last) {
+			node *tmp = now;
+			now = now->next;
+			delete tmp;
+		}
+		head->next = last;
+		last->prev = head;
+		current_size = 0;
 	}
+	void push_back(const T &value) {link(tail->prev, value);}
+	void push_back(T &&value) {link(tail->prev, std::move(value));}
 	void pop_back() {
 		if(empty()) throw container_is_empty();
 		--current_size;
@@ -207,12 +251,7 @@ public:
 		tmp->prev->next = tmp->next;
 		delete tmp;
 	}
-	void push_front(const T &value) {
-		++current_size;
-		node *new_node = new node(head, head->next, new T(value));
-		head->next->prev = new_node;
-		head->next = new_node;
-	}
+	void push_front(const T &value) {link(head->next, value);}
 	void pop_front() {
 		if(empty()) throw container_is_empty();
 		--current_size;
@@ -221,22 +260,8 @@ public:
 		tmp->prev->next = tmp->next;
 		delete tmp;
 	}
-	iterator insert(iterator pos, const T &value) {
-		++current_size;
-		node *tmp = pos.current_node;
-		node *new_node = new node(tmp->prev, tmp, new T(value));
-		tmp->prev->next = new_node;
-		tmp->prev = new_node;
-		return iterator(pos.index, new_node, this);
-	}
-	iterator insert(iterator pos, T &&value) {
-		++current_size;
-		node *tmp = pos.current_node;
-		node *new_node = new node(tmp->prev, tmp, new T(std::move(value)));
-		tmp->prev->next = new_node;
-		tmp->prev = new_node;
-		return iterator(pos.index, new_node, this);
-	}
+	iterator insert(iterator pos, const T &value) {return iterator(pos.index, link(pos.current_node, value), this);}
+	iterator insert(iterator pos, T &&value) {return iterator(pos.index, link(pos.current_node, std::move(value)), this);}
 	iterator erase(iterator pos) {
 		if(pos == end()) return pos;
 		--current_size;
@@ -249,8 +274,7 @@ public:
 	}
 	
 	list split(iterator it) {
-		size_t cnt = 0;
-		for(iterator itt = begin(); itt != it; ++itt, ++cnt);
+		size_t cnt = it.index;
 		list rtn;
 		node *tmp_head = it.current_node;
 		node *tmp_tail = tail->prev->prev;
@@ -267,6 +291,7 @@ public:
 	
 	void merge(list &other) {
 		current_size += other.current_size;
+		other.current_size = 0;
 		node *tmp_head = other.head->next;
 		node *tmp_tail = other.tail->prev->prev;
 		other.head->next = other.tail->prev;
@@ -278,32 +303,446 @@ public:
 	}
 };
 
+/**
+ * how a deque block keeps its elements: trivially copyable ones sit in the block's array,
+ * so copying, splitting and merging blocks is memcpy and freeing one never visits them;
+ * anything else is allocated on its own and the array holds pointers, NULL marks no element
+ */
+template<class T, bool = std::is_trivially_copyable<T>::value>
+struct block_items {
+	typedef T *item;
+	const static size_t HEAP = 1;
+	static T * address(item x) {return x;}
+	template<class V>
+	static void make(item *slot, V &&value) {*slot = new T(std::forward<V>(value));}
+	static void make_empty(item *slot) {*slot = NULL;}
+	static void destroy(item *first, size_t n) {
+		for(size_t i = 0; i < n; ++i) if(first[i] != NULL) delete first[i];
+	}
+	// if an element throws while copied, the copies made so far are deleted again
+	static void copy(item *dest, const item *src, size_t n) {
+		size_t i = 0;
+		try {
+			for(; i < n; ++i) dest[i] = src[i] == NULL ? NULL : new T(*src[i]);
+		} catch(...) {
+			destroy(dest, i);
+			throw;
+		}
+	}
+	static size_t heap_bytes(const item *first, size_t n) {
+		size_t rtn = 0;
+		for(size_t i = 0; i < n; ++i) rtn += first[i] != NULL;
+		return rtn * sizeof(T);
+	}
+};
+template<class T>
+struct block_items<T, true> {
+	typedef T item;
+	const static size_t HEAP = 0;
+	static T * address(item &x) {return &x;}
+	static const T * address(const item &x) {return &x;}
+	template<class V>
+	static void make(item *slot, V &&value) {new(slot) T(std::forward<V>(value));}
+	static void make_empty(item *) {}
+	static void destroy(item *, size_t) {}
+	static void copy(item *dest, const item *src, size_t n) {if(n > 0) std::memcpy(dest, src, n * sizeof(T));}
+	static size_t heap_bytes(const item *, size_t) {return 0;}
+};
+
 template<class T>
 class deque {
 	
-	typedef list<T*> inner_list_type;
-	typedef list<inner_list_type> outer_list_type;
+	/**
+	 * a run of elements in one array: trivially copyable ones in place, anything else as
+	 * pointers to its own allocations (block_items);
+	 * copies of a block share the array and the elements until one of them is changed,
+	 * that one first takes elements of its own (unshare), so a copy of the deque is O(blocks)
+	 * a block of trivially copyable elements can also live in a slot of a spill file, the
+	 * array is then that slot, mapped when touched while the file keeps a few mappings;
+	 * evict and fetch move it out and back
+	 * iterators hold the block and an index, unsharing leaves them valid
+	 */
+	class block {
+		typedef block_items<T> holder;
+		typedef typename holder::item item;
+		// file is NULL for an array in memory, otherwise items is the slot's mapping while ticket holds it
+		struct storage {
+			item *items;
+			size_t size, capacity;
+			std::atomic<size_t> refs;
+			spill_file *file;
+			size_t slot, ticket;
+			storage(size_t n) : items(allocate(n)), size(0), capacity(n), refs(1), file(NULL), slot(0), ticket(0) {}
+			~storage() {
+				if(file != NULL) {
+					file->release(slot, ticket);
+					file->drop();
+					return;
+				}
+				holder::destroy(items, size);
+				::operator delete(items);
+			}
+		};
+		storage *data;
+		
+		// raw slots, elements are only constructed in them once they are put in
+		static item * allocate(size_t n) {return n ? static_cast<item*>(::operator new(n * sizeof(item))) : NULL;}
+		void drop() {if(--data->refs == 0) delete data;}
+		void reserve(size_t n) {
+			if(n <= data->capacity) return;
+			fetch();
+			size_t capacity = data->capacity < 8 ? 8 : data->capacity;
+			while(capacity < n) capacity *= 2;
+			item *fresh = allocate(capacity);
+			if(data->size > 0) std::memcpy(fresh, data->items, data->size * sizeof(item));
+			::operator delete(data->items);
+			data->items = fresh;
+			data->capacity = capacity;
+		}
+	public:
+		class iterator {
+			friend class block;
+		private:
+			block *belong;
+			size_t index;
+		public:
+			iterator(block *_belong = NULL, size_t _index = 0) : belong(_belong), index(_index) {}
+			iterator operator+(int n) const {return iterator(belong, index + n);}
+			iterator operator-(int n) const {return iterator(belong, index - n);}
+			int operator-(const iterator &rhs) const {return index - rhs.index;}
+			iterator &operator+=(int n) {index += n; return *this;}
+			iterator &operator++() {++index; return *this;}
+			iterator &operator--() {--index; return *this;}
+			T * operator*() const {return holder::address(belong->array()[index]);}
+			bool operator==(const iterator &rhs) const {return index == rhs.index && belong == rhs.belong;}
+			bool operator!=(const iterator &rhs) const {return !operator==(rhs);}
+		};
+		class const_iterator {
+		private:
+			const block *belong;
+			size_t index;
+		public:
+			const_iterator(const block *_belong = NULL, size_t _index = 0) : belong(_belong), index(_index) {}
+			const_iterator operator+(int n) const {return const_iterator(belong, index + n);}
+			const_iterator operator-(int n) const {return const_iterator(belong, index - n);}
+			int operator-(const const_iterator &rhs) const {return index - rhs.index;}
+			const_iterator &operator+=(int n) {index += n; return *this;}
+			const_iterator &operator++() {++index; return *this;}
+			const_iterator &operator--() {--index; return *this;}
+			const T * operator*() const {return holder::address(belong->array()[index]);}
+			bool operator==(const const_iterator &rhs) const {return index == rhs.index && belong == rhs.belong;}
+			bool operator!=(const const_iterator &rhs) const {return !operator==(rhs);}
+		};
+	private:
+		// the element is made before anything moves, so value may be one of ours and a throw changes nothing
+		template<class V>
+		iterator put(iterator pos, V &&value) {
+			typename std::aligned_storage<sizeof(item), alignof(item)>::type slot;
+			holder::make(reinterpret_cast<item*>(&slot), std::forward<V>(value));
+			try {
+				unshare();
+				reserve(data->size + 1);
+			} catch(...) {
+				holder::destroy(reinterpret_cast<item*>(&slot), 1);
+				throw;
+			}
+			std::memmove(data->items + pos.index + 1, data->items + pos.index, (data->size - pos.index) * sizeof(item));
+			std::memcpy(static_cast<void*>(data->items + pos.index), &slot, sizeof(item));
+			++data->size;
+			return iterator(this, pos.index);
+		}
+	public:
+		block() : data(new storage(0)) {}
+		block(const block &other) : data(other.data) {++data->refs;}
+		block &operator=(const block &other) {
+			++other.data->refs;
+			drop();
+			data = other.data;
+			return *this;
+		}
+		~block() {drop();}
+		// copy the shared elements, every change below does this first
+		void unshare() {
+			if(data->refs == 1) {
+				array();
+				return;
+			}
+			storage *fresh = new storage(data->size);
+			try {
+				holder::copy(fresh->items, array(), data->size);
+			} catch(...) {
+				delete fresh;
+				throw;
+			}
+			fresh->size = data->size;
+			drop();
+			data = fresh;
+		}
+		// a spilled block becomes the newest mapping of its file, touching it again costs nothing
+		item * array() const {
+			if(data->file != NULL && (data->ticket == 0 || data->ticket != data->file->newest()))
+				data->items = static_cast<item*>(data->file->map(data->slot, data->ticket, data->items));
+			return data->items;
+		}
+		bool spilled() const {return data->file != NULL;}
+		// write the elements to a slot of file and free the array; shared blocks stay as they are
+		bool evict(spill_file *file) {
+			if(data->file != NULL || data->refs != 1 || data->size * sizeof(item) > file->slot_bytes()) return false;
+			size_t slot = file->take();
+			try {
+				file->write(slot, data->items, data->size * sizeof(item));
+			} catch(...) {
+				file->release(slot, 0);
+				throw;
+			}
+			::operator delete(data->items);
+			file->retain();
+			data->items = NULL;
+			data->capacity = file->slot_bytes() / sizeof(item);
+			data->file = file;
+			data->slot = slot;
+			data->ticket = 0;
+			return true;
+		}
+		// read the elements back into an array of the block's own
+		bool fetch() {
+			if(data->file == NULL) return false;
+			if(data->refs != 1) {
+				unshare();
+				return true;
+			}
+			size_t capacity = 8;
+			while(capacity < data->size) capacity *= 2;
+			item *fresh = allocate(capacity);
+			try {
+				if(data->file->mapped(data->ticket)) std::memcpy(static_cast<void*>(fresh), data->items, data->size * sizeof(item));
+				else data->file->read(data->slot, fresh, data->size * sizeof(item));
+			} catch(...) {
+				::operator delete(fresh);
+				throw;
+			}
+			data->file->release(data->slot, data->ticket);
+			data->file->drop();
+			data->items = fresh;
+			data->capacity = capacity;
+			data->file = NULL;
+			return true;
+		}
+		// the file starts reading a spilled block that is not mapped yet
+		void prefetch() const {if(data->file != NULL && !data->file->mapped(data->ticket)) data->file->prefetch(data->slot);}
+		size_t size() const {return data->size;}
+		bool empty() const {return data->size == 0;}
+		iterator begin() {return iterator(this, 0);}
+		iterator end() {return iterator(this, data->size);}
+		const_iterator cbegin() const {return const_iterator(this, 0);}
+		const_iterator cend() const {return const_iterator(this, data->size);}
+		// the array and the elements outside it, in full even when shared; a spilled block is on disk
+		memory_footprint memory_usage() const {
+			if(data->file != NULL) return memory_footprint(data->size, sizeof(T), 0, sizeof(block) + sizeof(storage));
+			return memory_footprint(data->size, sizeof(T), 0, sizeof(block) + sizeof(storage) +
+				data->capacity * sizeof(item) + holder::heap_bytes(data->items, data->size));
+		}
+		iterator insert(iterator pos, const T &value) {return put(pos, value);}
+		iterator insert(iterator pos, T &&value) {return put(pos, std::move(value));}
+		iterator erase(iterator pos) {return erase(pos, pos + 1);}
+		iterator erase(iterator first, iterator last) {
+			unshare();
+			holder::destroy(data->items + first.index, last.index - first.index);
+			std::memmove(data->items + first.index, data->items + last.index, (data->size - last.index) * sizeof(item));
+			data->size -= last.index - first.index;
+			return iterator(this, first.index);
+		}
+		template<class V>
+		void push_back(V &&value) {put(end(), std::forward<V>(value));}
+		template<class V>
+		void push_front(V &&value) {put(begin(), std::forward<V>(value));}
+		// the slot one past the last element of the deque
+		void push_end() {
+			unshare();
+			reserve(data->size + 1);
+			holder::make_empty(data->items + data->size);
+			++data->size;
+		}
+		void pop_back() {erase(end() - 1);}
+		void pop_front() {erase(begin());}
+		// the first element of other moves to the back of this block
+		void take_front(block &other) {
+			unshare();
+			other.unshare();
+			reserve(data->size + 1);
+			std::memcpy(data->items + data->size, other.data->items, sizeof(item));
+			std::memmove(other.data->items, other.data->items + 1, (other.data->size - 1) * sizeof(item));
+			++data->size;
+			--other.data->size;
+		}
+		// the elements from pos on move to the returned block
+		block split(iterator pos) {
+			unshare();
+			block rtn;
+			rtn.reserve(data->size - pos.index);
+			if(data->size > pos.index) std::memcpy(rtn.data->items, data->items + pos.index, (data->size - pos.index) * sizeof(item));
+			rtn.data->size = data->size - pos.index;
+			data->size = pos.index;
+			return rtn;
+		}
+		// every element of other moves to the back of this block
+		void merge(block &other) {
+			unshare();
+			other.unshare();
+			reserve(data->size + other.data->size);
+			if(other.data->size > 0) std::memcpy(data->items + data->size, other.data->items, other.data->size * sizeof(item));
+			data->size += other.data->size;
+			other.data->size = 0;
+		}
+	};
+	typedef list<block> outer_list_type;
 	
 	friend class iterator;
 	friend class const_iterator;
 	size_t current_size;
 	outer_list_type outer_list;
+	spill_file *spilling;
+	size_t hot;
 	const static size_t SIZE = 2048;
 	const static size_t BUFF_SIZE_HGH = SIZE;
 	const static size_t BUFF_SIZE_LOW = BUFF_SIZE_HGH / 2;
+public:
+	// allocations counts the elements pushed or inserted onto the heap (none when trivially copyable),
+	// not copies made when a shared block is unshared; spills and fetches count blocks written to
+	// and read back from the spill file
+	struct statistics {
+		size_t splits = 0, merges = 0, borrows = 0;
+		size_t step_overs = 0, blocks_walked = 0;
+		size_t allocations = 0;
+		size_t spills = 0, fetches = 0;
+	};
+private:
+#if SJTU_STATS
+	mutable statistics counters;
+#endif
 	
 	void fix(typename outer_list_type::iterator it) {
+		size_t blocks = outer_list.size();
+		reshape(it);
+		if(spilling == NULL) return;
+		if(outer_list.size() != blocks) settle_ends();
+		// it was only erased at an end, where it is not cold
+		if(!cold(it - outer_list.begin())) return;
+		evict(it);
+		if(it + 1 != outer_list.end() && cold(it - outer_list.begin() + 1)) evict(it + 1);
+	}
+	
+	void reshape(typename outer_list_type::iterator it) {
 		typename outer_list_type::iterator itt = it + 1;
-		if(it->size() > BUFF_SIZE_HGH) outer_list.insert(it + 1, (*it).split((*it).begin() + BUFF_SIZE_LOW));
+		if(it->size() > BUFF_SIZE_HGH) {
+			SJTU_COUNT(counters.splits, 1);
+			outer_list.insert(it + 1, (*it).split((*it).begin() + BUFF_SIZE_LOW));
+		}
 		if(it == outer_list.begin() || itt == outer_list.end()) {
 			if(!it->empty()) return;
 			outer_list.erase(it);
 		} else if(it->size() < BUFF_SIZE_LOW) {
-			if(itt->size() <= BUFF_SIZE_LOW) it->merge(*itt), outer_list.erase(itt);
-			else it->push_back(itt->front()), itt->pop_front();
+			if(itt->size() <= BUFF_SIZE_LOW) {
+				SJTU_COUNT(counters.merges, 1);
+				it->merge(*itt), outer_list.erase(itt);
+			} else {
+				SJTU_COUNT(counters.borrows, 1);
+				it->take_front(*itt);
+			}
+		}
+	}
+	
+	// the hot blocks at each end stay in memory, the ones between them go to the spill file
+	bool cold(size_t index) const {return index >= hot && index + hot < outer_list.size();}
+	void evict(typename outer_list_type::iterator it) {
+		if(it->evict(spilling)) SJTU_COUNT(counters.spills, 1);
+	}
+	void fetch(typename outer_list_type::iterator it) {
+		if(it->fetch()) SJTU_COUNT(counters.fetches, 1);
+	}
+	// after the block count changed by one near an end: O(hot); the block pop_front
+	// reaches next is read ahead while the head block is used up
+	void settle_ends() {
+		size_t blocks = outer_list.size();
+		typename outer_list_type::iterator it = outer_list.begin();
+		for(size_t i = 0; i < hot && i < blocks; ++i, ++it) fetch(it);
+		if(cold(hot)) {
+			evict(it);
+			it->prefetch();
+		}
+		it = outer_list.end() - 1;
+		for(size_t i = 0; i < hot && i < blocks; ++i, --it) fetch(it);
+		if(blocks > hot && cold(blocks - 1 - hot)) evict(it);
+	}
+	// after bulk changes: O(blocks); a deque that does not spill reads back every spilled
+	// block it got from another one, so only a spilling deque ever holds any
+	void settle_all() {
+		if(spilling == NULL) {
+			for(typename outer_list_type::iterator it = outer_list.begin(); it != outer_list.end(); ++it) fetch(it);
+			return;
+		}
+		size_t index = 0;
+		for(typename outer_list_type::iterator it = outer_list.begin(); it != outer_list.end(); ++it, ++index) {
+			if(cold(index)) evict(it);
+			else fetch(it);
 		}
+		if(cold(hot)) (outer_list.begin() + hot)->prefetch();
 	}
 	
+	// make the element at index the first one of its block, return that block
+	typename outer_list_type::iterator cut(size_t index) {
+		iterator pos = begin() + index;
+		typename outer_list_type::iterator it = pos.it_on_outer_list;
+		if(pos.it_on_inner_list == it->begin()) return it;
+		SJTU_COUNT(counters.splits, 1);
+		outer_list.insert(it + 1, (*it).split(pos.it_on_inner_list));
+		return it + 1;
+	}
+	
+	// restore block sizes over span consecutive blocks starting from it
+	void rebalance(typename outer_list_type::iterator it, size_t span) {
+		while(span > 0 && it != outer_list.end()) {
+			typename outer_list_type::iterator itt = it + 1;
+			if(span > 1 && itt != outer_list.end() && it->size() < BUFF_SIZE_LOW) {
+				SJTU_COUNT(counters.merges, 1);
+				if(!itt->empty()) it->merge(*itt);
+				outer_list.erase(itt);
+				--span;
+				if(it->size() <= BUFF_SIZE_HGH) continue;
+				SJTU_COUNT(counters.splits, 1);
+				outer_list.insert(it + 1, (*it).split((*it).begin() + it->size() / 2));
+				++span;
+			}
+			++it, --span;
+		}
+	}
+	
+	template<class InputIterator>
+	void fill_blocks(typename outer_list_type::iterator where, InputIterator first, InputIterator last) {
+		size_t index = where - outer_list.begin(), blocks = 0, count = 0;
+		typename outer_list_type::iterator now = where;
+		for(; first != last; ++first, ++count) {
+			if(blocks == 0 || now->size() == BUFF_SIZE_LOW)
+				now = outer_list.insert(blocks == 0 ? where : now + 1, block()), ++blocks;
+			now->push_back(*first);
+		}
+		SJTU_COUNT(counters.allocations, count * block_items<T>::HEAP);
+		current_size += count;
+		if(index == 0) rebalance(outer_list.begin(), blocks + 1);
+		else rebalance(outer_list.begin() + (index - 1), blocks + 2);
+		if(spilling != NULL) settle_all();
+	}
+	
+	class repeat_iterator {
+		size_t index;
+		const T *value;
+	public:
+		repeat_iterator(size_t _index, const T &_value) : index(_index), value(&_value) {}
+		const T& operator*() const {return *value;}
+		repeat_iterator& operator++() {++index; return *this;}
+		bool operator!=(const repeat_iterator &rhs) const {return index != rhs.index;}
+	};
+	
 public:
 	class const_iterator;
 	class iterator {
@@ -311,44 +750,54 @@ public:
 	private:
 		size_t index;
 		typename outer_list_type::iterator it_on_outer_list;
-		typename inner_list_type::iterator it_on_inner_list;
+		typename block::iterator it_on_inner_list;
 		deque *belong;
 	public:
 		iterator() {}
 		iterator(size_t _index, typename outer_list_type::iterator _it_on_outer_list,
-			typename inner_list_type::iterator _it_on_inner_list, const deque *_belong) :
+			typename block::iterator _it_on_inner_list, const deque *_belong) :
 			index(_index), it_on_outer_list(_it_on_outer_list), it_on_inner_list(_it_on_inner_list),
 			belong((deque*)_belong) {}
 		void step_over() {
 			size_t cnt = 0;
 			bool from_begin = index <= belong->current_size / 2;
 			size_t limit = from_begin ? index : belong->current_size - index;
+			SJTU_COUNT(belong->counters.step_overs, 1);
 			if(from_begin) for(it_on_outer_list = belong->outer_list.begin();
 				it_on_outer_list != belong->outer_list.end(); ++it_on_outer_list) {
+				SJTU_COUNT(belong->counters.blocks_walked, 1);
 				if(cnt + it_on_outer_list->size() > limit) break;
 				else cnt += it_on_outer_list->size();
 			}
 			else for(it_on_outer_list = belong->outer_list.end() - 1; 
 				it_on_outer_list != belong->outer_list.begin(); --it_on_outer_list) {
+				SJTU_COUNT(belong->counters.blocks_walked, 1);
 				if(cnt + it_on_outer_list->size() > limit) break;
 				else cnt += it_on_outer_list->size();
 			}
 			if(!from_begin) cnt = belong->current_size + 1 - cnt - it_on_outer_list->size();
 			it_on_inner_list = it_on_outer_list->begin();
-			while(cnt < index && it_on_inner_list != it_on_outer_list->end()) ++it_on_inner_list, ++cnt;
+			if(cnt < index) it_on_inner_list += index - cnt < it_on_outer_list->size() ? index - cnt : it_on_outer_list->size();
 		}
+		// a step of one into a neighbouring block moves there directly, anything else walks the blocks
 		iterator operator+(const int &n) const {
 			iterator rtn = *this;
 			rtn.index += n;
 			size_t high = it_on_outer_list->end() - it_on_inner_list - 1 + index;
 			size_t low = it_on_outer_list->begin() - it_on_inner_list + index;
 			if(low <= rtn.index && rtn.index <= high) rtn.it_on_inner_list += n;
-			else rtn.step_over();
+			else if(n == 1 && rtn.it_on_outer_list + 1 != belong->outer_list.end() && !(rtn.it_on_outer_list + 1)->empty()) {
+				++rtn.it_on_outer_list;
+				rtn.it_on_inner_list = rtn.it_on_outer_list->begin();
+			} else if(n == -1 && rtn.it_on_outer_list != belong->outer_list.begin() && !(rtn.it_on_outer_list - 1)->empty()) {
+				--rtn.it_on_outer_list;
+				rtn.it_on_inner_list = rtn.it_on_outer_list->end() - 1;
+			} else rtn.step_over();
 			return rtn;
 		}
 		iterator operator-(const int &n) const {return operator+(-n);}
 		int operator-(const iterator &rhs) const {
-			if(belong != rhs.belong) throw invalid_iterator();
+			SJTU_THROW_IF(belong != rhs.belong, invalid_iterator);
 			return index - rhs.index;
 		}
 		iterator operator+=(const int &n) {return *this = operator+(n);}
@@ -365,12 +814,16 @@ public:
 			return tmp;
 		}
 		iterator& operator--() {return *this = operator-(1);}
+		// a block shared with a copy of the deque is unshared before its element is handed out
 		T& operator*() const {
-			if(index < 0 || index >= belong->current_size) throw invalid_iterator();
-			if(*this == belong->end()) throw invalid_iterator();
+			SJTU_THROW_IF(index >= belong->current_size, invalid_iterator);
+			it_on_outer_list->unshare();
 			return **it_on_inner_list;
 		}
-		T* operator->() const noexcept {return &(**it_on_inner_list);}
+		T* operator->() const {
+			it_on_outer_list->unshare();
+			return &(**it_on_inner_list);
+		}
 		bool operator==(const iterator &rhs) const {
 			if(index != rhs.index) return false;
 			if(it_on_inner_list != rhs.it_on_inner_list) return false;
@@ -393,31 +846,34 @@ public:
 	private:
 		size_t index;
 		typename outer_list_type::const_iterator it_on_outer_list;
-		typename inner_list_type::const_iterator it_on_inner_list;
+		typename block::const_iterator it_on_inner_list;
 		deque *belong;
 	public:
 		const_iterator() {}
 		const_iterator(size_t _index, typename outer_list_type::const_iterator _it_on_outer_list,
-			typename inner_list_type::const_iterator _it_on_inner_list, const deque *_belong) :
+			typename block::const_iterator _it_on_inner_list, const deque *_belong) :
 			index(_index), it_on_outer_list(_it_on_outer_list), it_on_inner_list(_it_on_inner_list),
 			belong((deque*)_belong) {}
 		void step_over() {
 			size_t cnt = 0;
 			bool from_begin = index <= belong->current_size / 2;
 			size_t limit = from_begin ? index : belong->current_size - index;
+			SJTU_COUNT(belong->counters.step_overs, 1);
 			if(from_begin) for(it_on_outer_list = belong->outer_list.cbegin();
 				it_on_outer_list != belong->outer_list.cend(); ++it_on_outer_list) {
+				SJTU_COUNT(belong->counters.blocks_walked, 1);
 				if(cnt + it_on_outer_list->size() > limit) break;
 				else cnt += it_on_outer_list->size();
 			}
 			else for(it_on_outer_list = belong->outer_list.cend() - 1; 
 				it_on_outer_list != belong->outer_list.cbegin(); --it_on_outer_list) {
+				SJTU_COUNT(belong->counters.blocks_walked, 1);
 				if(cnt + it_on_outer_list->size() > limit) break;
 				else cnt += it_on_outer_list->size();
 			}
 			if(!from_begin) cnt = belong->current_size + 1 - cnt - it_on_outer_list->size();
 			it_on_inner_list = it_on_outer_list->cbegin();
-			while(cnt < index && it_on_inner_list != it_on_outer_list->cend()) ++it_on_inner_list, ++cnt;
+			if(cnt < index) it_on_inner_list += index - cnt < it_on_outer_list->size() ? index - cnt : it_on_outer_list->size();
 		}
 		const_iterator operator+(const int &n) const {
 			const_iterator rtn = *this;
@@ -425,13 +881,19 @@ public:
 			size_t high = it_on_outer_list->cend() - it_on_inner_list - 1 + index;
 			size_t low = it_on_outer_list->cbegin() - it_on_inner_list + index;
 			if(low <= rtn.index && rtn.index <= high) rtn.it_on_inner_list += n;
-			else rtn.step_over();
+			else if(n == 1 && rtn.it_on_outer_list + 1 != belong->outer_list.cend() && !(rtn.it_on_outer_list + 1)->empty()) {
+				++rtn.it_on_outer_list;
+				rtn.it_on_inner_list = rtn.it_on_outer_list->cbegin();
+			} else if(n == -1 && rtn.it_on_outer_list != belong->outer_list.cbegin() && !(rtn.it_on_outer_list - 1)->empty()) {
+				--rtn.it_on_outer_list;
+				rtn.it_on_inner_list = rtn.it_on_outer_list->cend() - 1;
+			} else rtn.step_over();
 			return rtn;
 		}
 		const_iterator operator-(const int &n) const {return operator+(-n);
 		}
 		int operator-(const const_iterator &rhs) const {
-			if(belong != rhs.belong) throw invalid_iterator();
+			SJTU_THROW_IF(belong != rhs.belong, invalid_iterator);
 			return index - rhs.index;
 		}
 		const_iterator operator+=(const int &n) {return *this = operator+(n);}
@@ -449,8 +911,7 @@ public:
 		}
 		const_iterator& operator--() {return *this = operator-(1);}
 		const T& operator*() const {
-			if(index < 0 || index >= belong->current_size) throw invalid_iterator();
-			if(*this == belong->cend()) throw invalid_iterator();
+			SJTU_THROW_IF(index >= belong->current_size, invalid_iterator);
 			return **it_on_inner_list;
 		}
 		const T* operator->() const noexcept {return &(**it_on_inner_list);}
@@ -471,23 +932,23 @@ public:
 		bool operator!=(const iterator &rhs) const {return !operator==(rhs);}
 		bool operator!=(const const_iterator &rhs) const {return !operator==(rhs);}
 	};
-	deque() {
+	deque() : spilling(NULL), hot(0) {
 		current_size = 0;
-		inner_list_type inner_list;
-		inner_list.push_back(NULL);
-		outer_list.push_back(inner_list);
+		block sentinel;
+		sentinel.push_end();
+		outer_list.push_back(sentinel);
 	}
+	// the blocks are shared, their elements are copied right away unless share_on_copy<T>;
+	// whether to spill is not copied, shared blocks are not spilled
 	void copy(const deque &other) {
 		if(this == &other) return;
-		clear();
-		for(const_iterator it = other.cbegin(); it != other.cend(); ++it)
-			push_back(*it);
+		outer_list = other.outer_list;
+		current_size = other.current_size;
+		if(!share_on_copy<T>::value) unshare();
+		if(spilling != NULL || other.spilling != NULL) settle_all();
 	}
 	deque(const deque &other) : deque() {copy(other);}
-	~deque() {
-		for(iterator it = begin(); it != end(); ++it)
-			delete *it.it_on_inner_list;
-	}
+	~deque() {if(spilling != NULL) spilling->drop();}
 	deque &operator=(const deque &other) {
 		copy(other);
 		return *this;
@@ -500,8 +961,17 @@ public:
 		if(pos >= current_size) throw index_out_of_bound();
 		return *(cbegin() + pos);
 	}
-	T & operator[](const size_t &pos) {return at(pos);}
-	const T & operator[](const size_t &pos) const {return at(pos);}
+	T & operator[](const size_t &pos) {
+		SJTU_THROW_IF(pos >= current_size, index_out_of_bound);
+		return *(begin() + pos);
+	}
+	const T & operator[](const size_t &pos) const {
+		SJTU_THROW_IF(pos >= current_size, index_out_of_bound);
+		return *(cbegin() + pos);
+	}
+	// NULL instead of index_out_of_bound
+	T * try_at(const size_t &pos) {return pos < current_size ? &*(begin() + pos) : NULL;}
+	const T * try_at(const size_t &pos) const {return pos < current_size ? &*(cbegin() + pos) : NULL;}
 	const T & front() const {
 		if(empty()) throw container_is_empty();
 		return *cbegin();
@@ -522,29 +992,89 @@ public:
 	}
 	bool empty() const {return current_size == 0;}
 	size_t size() const {return current_size;}
+	// O(blocks), each block's array plus the elements allocated outside it;
+	// a block shared with a copy is counted in full by both, a spilled one not at all
+	memory_footprint memory_usage() const {
+		memory_footprint outer = outer_list.memory_usage();
+		size_t bytes = sizeof(deque) + outer.bytes - sizeof(outer_list_type);
+		for(typename outer_list_type::const_iterator it = outer_list.cbegin(); it != outer_list.cend(); ++it)
+			bytes += it->memory_usage().bytes - sizeof(block);
+		return memory_footprint(current_size, sizeof(T), outer.nodes, bytes);
+	}
+#if SJTU_STATS
+	statistics stats() const {return counters;}
+	void reset_stats() {counters = statistics();}
+#else
+	statistics stats() const {return statistics();}
+	void reset_stats() {}
+#endif
 	void clear() {
-		for(iterator it = begin(); it != end(); ++it) {
-			if(*(it.it_on_inner_list) == NULL) continue;
-			delete *(it.it_on_inner_list);
-			*(it.it_on_inner_list) = NULL;
-		}
 		current_size = 0;
 		outer_list.clear();
-		inner_list_type inner_list;
-		inner_list.push_back(NULL);
-		outer_list.push_back(inner_list);
+		block sentinel;
+		sentinel.push_end();
+		outer_list.push_back(sentinel);
+	}
+	// give every block elements of its own, e.g. before several threads write through iterators
+	void unshare() {
+		for(typename outer_list_type::iterator it = outer_list.begin(); it != outer_list.end(); ++it) it->unshare();
+	}
+	// iterators to the ascending ranks[0..n), found in one walk over the blocks and not counted in stats()
+	void locate(const size_t *ranks, size_t n, iterator *out) {
+		size_t k = 0, cnt = 0;
+		for(typename outer_list_type::iterator it = outer_list.begin(); k < n && it != outer_list.end(); ++it) {
+			for(; k < n && ranks[k] < cnt + it->size(); ++k) out[k] = iterator(ranks[k], it, it->begin() + int(ranks[k] - cnt), this);
+			cnt += it->size();
+		}
 	}
+	void locate(const size_t *ranks, size_t n, const_iterator *out) const {
+		size_t k = 0, cnt = 0;
+		for(typename outer_list_type::const_iterator it = outer_list.cbegin(); k < n && it != outer_list.cend(); ++it) {
+			for(; k < n && ranks[k] < cnt + it->size(); ++k) out[k] = const_iterator(ranks[k], it, it->cbegin() + int(ranks[k] - cnt), this);
+			cnt += it->size();
+		}
+	}
+	/**
+	 * keep only about budget bytes of elements in memory, split between the hot blocks at
+	 * the two ends; every block between them is written to an unlinked temp file in dir
+	 * (NULL: $TMPDIR or /tmp) and mapped back when touched, so pushes and pops at the ends
+	 * stay in memory and the size is bounded by the disk; the block pop_front reaches next
+	 * is read ahead asynchronously (posix_fadvise); T must be trivially copyable
+	 * only spill_file::MAPPINGS spilled blocks are mapped at a time, so a reference into one
+	 * lasts until the next change or until that many other spilled blocks are touched;
+	 * single threaded, parallel.hpp walks a spilling deque on one thread
+	 */
+	void spill(size_t budget, const char *dir = NULL) {
+		static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable elements can be spilled");
+		spill_file *file = new spill_file(dir, 2 * SIZE * sizeof(T));
+		if(spilling != NULL) spilling->drop();
+		spilling = file;
+		hot = budget / (4 * SIZE * sizeof(T));
+		if(hot == 0) hot = 1;
+		settle_all();
+	}
+	// read every block back and stop spilling
+	void unspill() {
+		if(spilling == NULL) return;
+		for(typename outer_list_type::iterator it = outer_list.begin(); it != outer_list.end(); ++it) fetch(it);
+		spilling->drop();
+		spilling = NULL;
+		hot = 0;
+	}
+	bool spilling_enabled() const {return spilling != NULL;}
 	void push_back(const T &value) {
 		auto it_on_outer_list = end().it_on_outer_list;
 		auto it_on_inner_list = end().it_on_inner_list;
-		it_on_outer_list->insert(it_on_inner_list, new T(value));
+		SJTU_COUNT(counters.allocations, block_items<T>::HEAP);
+		it_on_outer_list->insert(it_on_inner_list, value);
 		++current_size;
 		fix(it_on_outer_list);
 	}
 	void push_back(T &&value) {
 		auto it_on_outer_list = end().it_on_outer_list;
 		auto it_on_inner_list = end().it_on_inner_list;
-		it_on_outer_list->insert(it_on_inner_list, new T(std::move(value)));
+		SJTU_COUNT(counters.allocations, block_items<T>::HEAP);
+		it_on_outer_list->insert(it_on_inner_list, std::move(value));
 		++current_size;
 		fix(it_on_outer_list);
 	}
@@ -553,60 +1083,115 @@ public:
 		auto it = end() - 1;
 		auto it_on_outer_list = it.it_on_outer_list;
 		auto it_on_inner_list = it.it_on_inner_list;
-		delete *it_on_inner_list;
 		it_on_outer_list->erase(it_on_inner_list);
 		--current_size;
 		fix(it_on_outer_list);
 	}
 	void push_front(const T &value) {
 		auto it_on_outer_list = begin().it_on_outer_list;
-		it_on_outer_list->push_front(new T(value));
+		SJTU_COUNT(counters.allocations, block_items<T>::HEAP);
+		it_on_outer_list->push_front(value);
 		++current_size;
 		fix(it_on_outer_list);
 	}
 	void pop_front() {
 		if(empty()) throw container_is_empty();
-		delete *begin().it_on_inner_list;
 		auto it_on_outer_list = begin().it_on_outer_list;
 		it_on_outer_list->pop_front();
 		--current_size;
 		fix(it_on_outer_list);
 	}
 	iterator insert(iterator pos, const T &value) {
-		if(pos.belong != this) throw invalid_iterator();
-		if(pos.index > current_size) throw invalid_iterator();
+		SJTU_THROW_IF(pos.belong != this || pos.index > current_size, invalid_iterator);
 		pos = begin() + pos.index;
 		if(pos == begin()) {push_front(value);return begin();}
 		if(pos == end()) {push_back(value); return end() - 1;}
-		pos.it_on_outer_list->insert(pos.it_on_inner_list, new T(value));
+		SJTU_COUNT(counters.allocations, block_items<T>::HEAP);
+		pos.it_on_outer_list->insert(pos.it_on_inner_list, value);
 		++current_size;
 		fix(pos.it_on_outer_list);
 		return begin() + pos.index;
 	}
 	iterator insert(iterator pos, T &&value) {
-		if(pos.belong != this) throw invalid_iterator();
-		if(pos.index > current_size) throw invalid_iterator();
+		SJTU_THROW_IF(pos.belong != this || pos.index > current_size, invalid_iterator);
 		pos = begin() + pos.index;
 		if(pos == begin()) {push_front(value); return begin();}
 		if(pos == end()) {push_back(value); return end() - 1;}
-		pos.it_on_outer_list->insert(pos.it_on_inner_list, new T(std::move(value)));
+		SJTU_COUNT(counters.allocations, block_items<T>::HEAP);
+		pos.it_on_outer_list->insert(pos.it_on_inner_list, std::move(value));
 		++current_size;
 		fix(pos.it_on_outer_list);
 		return begin() + pos.index;
 	}
 	iterator erase(iterator pos) {
-		if(pos.belong != this) throw invalid_iterator();
-		if(pos.index >= current_size) throw invalid_iterator();
+		SJTU_THROW_IF(pos.belong != this || pos.index >= current_size, invalid_iterator);
 		pos = begin() + pos.index;
 		if(pos == end()) return pos;
 		if(pos == begin()) {pop_front(); return begin();}
 		if(pos == end() - 1) {pop_back(); return end();}
 		--current_size;
-		delete *pos.it_on_inner_list;
 		pos.it_on_outer_list->erase(pos.it_on_inner_list);
 		fix(pos.it_on_outer_list);
 		return begin() + pos.index;
 	}
+	template<class InputIterator, class = typename std::enable_if<!std::is_integral<InputIterator>::value>::type>
+	iterator insert(iterator pos, InputIterator first, InputIterator last) {
+		SJTU_THROW_IF(pos.belong != this || pos.index > current_size, invalid_iterator);
+		size_t index = pos.index;
+		if(first != last) fill_blocks(cut(index), first, last);
+		return begin() + index;
+	}
+	iterator insert(iterator pos, size_t count, const T &value) {
+		SJTU_THROW_IF(pos.belong != this || pos.index > current_size, invalid_iterator);
+		size_t index = pos.index;
+		if(count > 0) fill_blocks(cut(index), repeat_iterator(0, value), repeat_iterator(count, value));
+		return begin() + index;
+	}
+	iterator erase(iterator first, iterator last) {
+		SJTU_THROW_IF(first.belong != this || last.belong != this, invalid_iterator);
+		SJTU_THROW_IF(first.index > last.index || last.index > current_size, invalid_iterator);
+		size_t index = first.index, count = last.index - first.index;
+		if(count == 0) return begin() + index;
+		typename outer_list_type::iterator it = cut(index);
+		size_t position = it - outer_list.begin();
+		current_size -= count;
+		while(count > 0) {
+			if(it->size() <= count) {
+				count -= it->size();
+				it = outer_list.erase(it);
+			} else {
+				it->erase(it->begin(), it->begin() + count);
+				count = 0;
+			}
+		}
+		if(position > 0) rebalance(outer_list.begin() + (position - 1), 2);
+		if(spilling != NULL) settle_all();
+		return begin() + index;
+	}
+	void append(deque &&other) {
+		if(this == &other || other.empty()) return;
+		typename outer_list_type::iterator it = outer_list.end() - 1;
+		size_t position = it - outer_list.begin();
+		it->pop_back();
+		outer_list.merge(other.outer_list);
+		current_size += other.current_size;
+		other.current_size = 0;
+		block sentinel;
+		sentinel.push_end();
+		other.outer_list.push_back(sentinel);
+		if(position == 0) rebalance(outer_list.begin(), 2);
+		else rebalance(outer_list.begin() + (position - 1), 3);
+		if(spilling != NULL || other.spilling != NULL) settle_all();
+	}
+	template<class InputIterator, class = typename std::enable_if<!std::is_integral<InputIterator>::value>::type>
+	void assign(InputIterator first, InputIterator last) {
+		clear();
+		insert(begin(), first, last);
+	}
+	void assign(size_t count, const T &value) {
+		clear();
+		insert(begin(), count, value);
+	}
 };
 
 }
@@ -5,38 +5,59 @@
 #include <cstring>
 #include <string>
 
+/**
+ * SJTU_CHECKED = 0 drops the bounds and iterator-ownership checks from the containers,
+ * misuse is then undefined behaviour; at(), empty-container and value checks always stay
+ */
+#ifndef SJTU_CHECKED
+#define SJTU_CHECKED 1
+#endif
+
+#if SJTU_CHECKED
+#define SJTU_THROW_IF(condition, error) do {if(condition) throw error();} while(0)
+#else
+#define SJTU_THROW_IF(condition, error) ((void)0)
+#endif
+
 namespace sjtu {
 
+// exceptions only carry pointers to static strings, throwing and copying never allocates
 class exception {
 protected:
-	const std::string variant = "";
-	std::string detail = "";
+	const char *variant;
+	const char *detail;
 public:
-	exception() {}
-	exception(const exception &ec) : variant(ec.variant), detail(ec.detail) {}
-	virtual std::string what() {
-		return variant + " " + detail;
+	exception(const char *_variant = "exception", const char *_detail = "") noexcept :
+		variant(_variant), detail(_detail) {}
+	exception(const exception &ec) noexcept : variant(ec.variant), detail(ec.detail) {}
+	exception &operator=(const exception &ec) noexcept {
+		variant = ec.variant;
+		detail = ec.detail;
+		return *this;
 	}
+	virtual ~exception() {}
+	virtual const char *what() const noexcept {return variant;}
+	const char *why() const noexcept {return detail;}
 };
 
-/**
- * TODO
- * Please complete them.
- */
 class index_out_of_bound : public exception {
-	/* __________________________ */
+public:
+	index_out_of_bound(const char *_detail = "") noexcept : exception("index_out_of_bound", _detail) {}
 };
 
 class runtime_error : public exception {
-	/* __________________________ */
+public:
+	runtime_error(const char *_detail = "") noexcept : exception("runtime_error", _detail) {}
 };
 
 class invalid_iterator : public exception {
-	/* __________________________ */
+public:
+	invalid_iterator(const char *_detail = "") noexcept : exception("invalid_iterator", _detail) {}
 };
 
 class container_is_empty : public exception {
-	/* __________________________ */
+public:
+	container_is_empty(const char *_detail = "") noexcept : exception("container_is_empty", _detail) {}
 };
 }
 
@@ -2,13 +2,25 @@
 #define SJTU_MAP_HPP
 #include <functional>
 #include <cstddef>
+#include <tuple>
 #include "utility.hpp"
 #include "exceptions.hpp"
+#include "stats.hpp"
 namespace sjtu {
 template<class Key, class T, class Compare = std::less<Key> > class map {
 public:
 	typedef pair<const Key, T> value_type;
+	// depths count the nodes visited below the root
+	struct statistics {
+		size_t rotations = 0, balances = 0, swaps = 0;
+		size_t finds = 0, find_depth = 0, find_depth_max = 0;
+		size_t inserts = 0, insert_depth = 0, insert_depth_max = 0;
+		size_t allocations = 0;
+	};
 private:
+#if SJTU_STATS
+	mutable statistics counters;
+#endif
 	friend class iterator;
 	friend class const_iterator;
 	Compare comparator;
@@ -39,8 +51,9 @@ private:
 		destroy(now->child[1]);
 		delete now;
 	}
-	size_t get_size(node *ptr) {return ptr ? ptr->size : 0;}
+	static size_t get_size(node *ptr) {return ptr ? ptr->size : 0;}
 	void rotate(node *&now, bool type) { // 0-left, 1-right
+		SJTU_COUNT(counters.rotations, 1);
 		node *tmp = now->child[!type];
 		now->child[!type] = tmp->child[type];
 		if(now->child[!type]) now->child[!type]->father = now;
@@ -53,6 +66,7 @@ private:
 	}
 	void balance(node *&now, bool type) { // 1-rson_deeper
 		if(now->child[type] == NULL) return;
+		SJTU_COUNT(counters.balances, 1);
 		if(get_size(now->child[type]->child[type]) > get_size(now->child[!type])) rotate(now, !type);
 		else if(get_size(now->child[type]->child[!type]) > get_size(now->child[!type])) rotate(now->child[type], type), rotate(now, !type);
 			 else return;
@@ -77,19 +91,24 @@ private:
 			return tmp == NULL ? now : tmp;
 		}
 	}
-	node *insert(node *&now, const value_type &value, node *father) {
+	node *insert(node *&now, value_type *value, node *father, size_t depth = 0) {
 		if(now == NULL) {
-			node *tmp = new node(new value_type(value));
-			tmp->enlink(next(root, true, value.first), next(root, false, value.first));
+			SJTU_COUNT(counters.inserts, 1);
+			SJTU_COUNT(counters.insert_depth, depth);
+			SJTU_COUNT_MAX(counters.insert_depth_max, depth);
+			SJTU_COUNT(counters.allocations, 2); // the node and its value
+			node *tmp = new node(value);
+			tmp->enlink(next(root, true, value->first), next(root, false, value->first));
 			tmp->father = father;
 			return now = tmp;
 		}
 		++now->size;
-		node *rtn = insert(now->child[cmp(now, value.first)], value, now);
-		balance(now, cmp(now, value.first));
+		node *rtn = insert(now->child[cmp(now, value->first)], value, now, depth + 1);
+		balance(now, cmp(now, value->first));
 		return rtn;
 	}
 	void swap(node *&x, node *&y) {
+		SJTU_COUNT(counters.swaps, 1);
 		node tx = *x, ty = *y;
 		tx.value = ty.value = NULL;
 		x->size = ty.size;
@@ -131,8 +150,54 @@ private:
 		now = tmp;
 	}
 	node *find(node *now, const Key &key) const {
-		if(now == NULL || !(cmp(now, key) || cmp(key, now))) return now;
-		return find(now->child[cmp(now, key)], key);
+		size_t depth = 0;
+		while(now != NULL && (cmp(now, key) || cmp(key, now))) now = now->child[cmp(now, key)], ++depth;
+		SJTU_COUNT(counters.finds, 1);
+		SJTU_COUNT(counters.find_depth, depth);
+		SJTU_COUNT_MAX(counters.find_depth_max, depth);
+		return now;
+	}
+	/**
+	 * up to BATCH descents advance one level per round; each round first prefetches the values
+	 * of the nodes the lanes stand on, then compares and prefetches the children they move to,
+	 * so the cache misses of different keys overlap instead of following each other
+	 */
+	const static size_t BATCH = 8;
+	// out[i] = the node of keys[i] or NULL, for n <= BATCH keys
+	void find_nodes(const Key *keys, size_t n, node **out) const {
+		size_t lane[BATCH], active = n;
+		node *now[BATCH];
+		for(size_t i = 0; i < n; ++i) lane[i] = i, now[i] = root;
+		for(size_t depth = 0; active > 0; ++depth) {
+			for(size_t i = 0; i < active; ++i) SJTU_PREFETCH(now[i]->value);
+			for(size_t i = 0; i < active; ) {
+				const Key &key = keys[lane[i]];
+				bool right = cmp(now[i], key);
+				node *tmp = right || cmp(key, now[i]) ? now[i]->child[right] : now[i];
+				if(tmp == now[i] || tmp == NULL) {
+					SJTU_COUNT(counters.finds, 1);
+					SJTU_COUNT(counters.find_depth, depth);
+					SJTU_COUNT_MAX(counters.find_depth_max, depth);
+					out[lane[i]] = tmp;
+					--active; // the last active lane takes this one's place
+					lane[i] = lane[active], now[i] = now[active];
+				} else {
+					SJTU_PREFETCH(tmp);
+					now[i++] = tmp;
+				}
+			}
+		}
+	}
+	// subtree sizes count the end node too, which ranks after every element
+	node *rank_node(size_t rank) const {
+		if(rank >= current_size) return finish;
+		node *now = root;
+		while(true) {
+			size_t left = get_size(now->child[0]);
+			if(rank < left) now = now->child[0];
+			else if(rank == left) return now;
+			else rank -= left + 1, now = now->child[1];
+		}
 	}
 	node *root, *finish;
 	size_t current_size;
@@ -152,7 +217,7 @@ public:
 			return rtn;
 		}
 		iterator & operator++() {
-			if(node_ptr->next[1] == NULL) throw index_out_of_bound();
+			SJTU_THROW_IF(node_ptr->next[1] == NULL, index_out_of_bound);
 			node_ptr = node_ptr->next[1];
 			return *this;
 		}
@@ -162,12 +227,12 @@ public:
 			return rtn;
 		}
 		iterator & operator--() {
-			if(node_ptr->next[0] == NULL) throw index_out_of_bound();
+			SJTU_THROW_IF(node_ptr->next[0] == NULL, index_out_of_bound);
 			node_ptr = node_ptr->next[0];
 			return *this;
 		}
 		value_type & operator*() const {
-			if(node_ptr == NULL || node_ptr->value == NULL) throw invalid_iterator();
+			SJTU_THROW_IF(node_ptr == NULL || node_ptr->value == NULL, invalid_iterator);
 			return *node_ptr->value;
 		}
 		bool operator==(const iterator &rhs) const {
@@ -204,7 +269,7 @@ public:
 			return rtn;
 		}
 		const_iterator & operator++() {
-			if(node_ptr->next[1] == NULL) throw index_out_of_bound();
+			SJTU_THROW_IF(node_ptr->next[1] == NULL, index_out_of_bound);
 			node_ptr = node_ptr->next[1];
 			return *this;
 		}
@@ -214,12 +279,12 @@ public:
 			return rtn;
 		}
 		const_iterator & operator--() {
-			if(node_ptr->next[0] == NULL) throw index_out_of_bound();
+			SJTU_THROW_IF(node_ptr->next[0] == NULL, index_out_of_bound);
 			node_ptr = node_ptr->next[0];
 			return *this;
 		}
 		const value_type & operator*() const {
-			if(node_ptr == NULL || node_ptr->value == NULL) throw invalid_iterator();
+			SJTU_THROW_IF(node_ptr == NULL || node_ptr->value == NULL, invalid_iterator);
 			return *node_ptr->value;
 		}
 		bool operator==(const iterator &rhs) const {
@@ -259,11 +324,20 @@ public:
 		node *node_ptr = find(root, key);
 		if(node_ptr == NULL) {
 			++current_size;
-			node_ptr = insert(root, value_type(key, T()), NULL);
+			node_ptr = insert(root, new value_type(std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>()), NULL);
 		}
 		return (*node_ptr->value).second;
 	}
 	const T & operator[](const Key &key) const {return at(key);}
+	// NULL instead of index_out_of_bound
+	T * try_at(const Key &key) {
+		node *node_ptr = find(root, key);
+		return node_ptr == NULL ? NULL : &(*node_ptr->value).second;
+	}
+	const T * try_at(const Key &key) const {
+		node *node_ptr = find(root, key);
+		return node_ptr == NULL ? NULL : &(*node_ptr->value).second;
+	}
 	iterator begin() {
 		node *node_ptr = root;
 		while(node_ptr->child[0]) node_ptr = node_ptr->child[0];
@@ -278,22 +352,42 @@ public:
 	const_iterator cend() const {return const_iterator(finish, this);}
 	bool empty() const {return current_size == 0;}
 	size_t size() const {return current_size;}
+	// a node per element plus the end node, each value_type allocated on its own
+	memory_footprint memory_usage() const {
+		return memory_footprint(current_size, sizeof(value_type), current_size + 1,
+			sizeof(map) + (current_size + 1) * sizeof(node) + current_size * sizeof(value_type));
+	}
+#if SJTU_STATS
+	statistics stats() const {return counters;}
+	void reset_stats() {counters = statistics();}
+#else
+	statistics stats() const {return statistics();}
+	void reset_stats() {}
+#endif
 	void clear() {
 		current_size = 0;
 		destroy(root);
+		SJTU_COUNT(counters.allocations, 1);
 		finish = root = new node(NULL);
 	}
 	pair<iterator, bool> insert(const value_type &value) {
 		iterator it = find(value.first);
 		if(it == end()) {
 			++current_size;
-			return pair<iterator, bool>(iterator(insert(root, value, NULL), this), true);
+			return pair<iterator, bool>(iterator(insert(root, new value_type(value), NULL), this), true);
+		} else return pair<iterator, bool>(it, false);
+	}
+	pair<iterator, bool> insert(value_type &&value) {
+		iterator it = find(value.first);
+		if(it == end()) {
+			++current_size;
+			return pair<iterator, bool>(iterator(insert(root, new value_type(std::move(value)), NULL), this), true);
 		} else return pair<iterator, bool>(it, false);
 	}
 	void erase(iterator pos) {
-		if(pos.belong != this) throw invalid_iterator();
+		SJTU_THROW_IF(pos.belong != this, invalid_iterator);
 		Key key = (*pos).first;
-		if(find(root, key) == NULL) throw invalid_iterator();
+		SJTU_THROW_IF(find(root, key) == NULL, invalid_iterator);
 		--current_size;
 		erase(root, key);
 	}
@@ -311,6 +405,37 @@ public:
 		if(node_ptr == NULL) return cend();
 		else return const_iterator(node_ptr, this);
 	}
+	// out[i] = find(keys[i]) for every i < n, the lookups overlap their cache misses
+	void find_batch(const Key *keys, size_t n, iterator *out) {
+		node *found[BATCH];
+		for(size_t first = 0; first < n; first += BATCH) {
+			size_t lanes = n - first < BATCH ? n - first : BATCH;
+			find_nodes(keys + first, lanes, found);
+			for(size_t i = 0; i < lanes; ++i) out[first + i] = iterator(found[i] ? found[i] : finish, this);
+		}
+	}
+	void find_batch(const Key *keys, size_t n, const_iterator *out) const {
+		node *found[BATCH];
+		for(size_t first = 0; first < n; first += BATCH) {
+			size_t lanes = n - first < BATCH ? n - first : BATCH;
+			find_nodes(keys + first, lanes, found);
+			for(size_t i = 0; i < lanes; ++i) out[first + i] = const_iterator(found[i] ? found[i] : finish, this);
+		}
+	}
+	// how many of keys[0..n) are in the map
+	size_t count_batch(const Key *keys, size_t n) const {
+		node *found[BATCH];
+		size_t rtn = 0;
+		for(size_t first = 0; first < n; first += BATCH) {
+			size_t lanes = n - first < BATCH ? n - first : BATCH;
+			find_nodes(keys + first, lanes, found);
+			for(size_t i = 0; i < lanes; ++i) rtn += found[i] != NULL;
+		}
+		return rtn;
+	}
+	// the element with rank elements before it, end() if rank >= size(); O(log n)
+	iterator find_rank(size_t rank) {return iterator(rank_node(rank), this);}
+	const_iterator find_rank(size_t rank) const {return const_iterator(rank_node(rank), this);}
 };
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,122 @@
+#ifndef SJTU_PARALLEL_HPP
+#define SJTU_PARALLEL_HPP
+
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+#include "deque.hpp"
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+ * read-mostly scans of a map or deque on several threads (link with -pthread)
+ * the elements are cut into one run of consecutive ranks per thread: the calling thread
+ * finds the start of every run before any of them begins, a map through its subtree sizes,
+ * a deque in one walk over its blocks; every thread then steps through its run without
+ * locks, so the container must not be modified meanwhile; threads = 0 takes every hardware thread
+ */
+template<class Key, class T, class Compare>
+void parallel_starts(map<Key, T, Compare> &m, const size_t *ranks, size_t n, typename map<Key, T, Compare>::iterator *out) {
+	for(size_t i = 0; i < n; ++i) out[i] = m.find_rank(ranks[i]);
+}
+template<class Key, class T, class Compare>
+void parallel_starts(const map<Key, T, Compare> &m, const size_t *ranks, size_t n, typename map<Key, T, Compare>::const_iterator *out) {
+	for(size_t i = 0; i < n; ++i) out[i] = m.find_rank(ranks[i]);
+}
+template<class T>
+void parallel_starts(deque<T> &d, const size_t *ranks, size_t n, typename deque<T>::iterator *out) {d.locate(ranks, n, out);}
+template<class T>
+void parallel_starts(const deque<T> &d, const size_t *ranks, size_t n, typename deque<T>::const_iterator *out) {d.locate(ranks, n, out);}
+
+// the iterator a run steps through, a const container gives const iterators
+template<class Container>
+struct parallel_iterator {typedef typename Container::iterator type;};
+template<class Container>
+struct parallel_iterator<const Container> {typedef typename Container::const_iterator type;};
+
+// a deque copy shares blocks with its original, it takes its own before threads write to it
+template<class Container>
+void parallel_prepare(Container &) {}
+template<class T>
+void parallel_prepare(deque<T> &d) {d.unshare();}
+
+// a spilling deque maps its blocks a few at a time as they are touched, one thread walks it
+template<class Container>
+size_t parallel_limit(const Container &, size_t threads) {return threads;}
+template<class T>
+size_t parallel_limit(const deque<T> &d, size_t threads) {return d.spilling_enabled() ? 1 : threads;}
+
+// how many runs n elements are cut into
+inline size_t parallel_threads(size_t n, size_t threads) {
+	if(threads == 0) threads = std::thread::hardware_concurrency();
+	if(threads == 0) threads = 1;
+	return threads < n ? threads : n;
+}
+
+// run part(i, first, count) for each of the runs on its own thread, the first on the caller;
+// the first exception thrown by any run is rethrown once all of them are done
+template<class Container, class Part>
+void parallel_runs(Container &c, size_t threads, Part part) {
+	size_t n = c.size();
+	if(threads == 0) return;
+	std::vector<size_t> ranks(threads + 1);
+	for(size_t i = 0; i <= threads; ++i) ranks[i] = i * n / threads;
+	std::vector<typename parallel_iterator<Container>::type> starts(threads);
+	parallel_starts(c, ranks.data(), threads, starts.data());
+	std::vector<std::exception_ptr> errors(threads);
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	// a thread that cannot be started leaves the ones running to be joined before rethrowing
+	try {
+		for(size_t i = threads; i-- > 0; ) {
+			auto run = [&part, &errors, &starts, &ranks, i]() {
+				try {
+					part(i, starts[i], ranks[i + 1] - ranks[i]);
+				} catch(...) {
+					errors[i] = std::current_exception();
+				}
+			};
+			if(i > 0) workers.emplace_back(run);
+			else run();
+		}
+	} catch(...) {
+		for(size_t i = 0; i < workers.size(); ++i) workers[i].join();
+		throw;
+	}
+	for(size_t i = 0; i < workers.size(); ++i) workers[i].join();
+	for(size_t i = 0; i < threads; ++i) if(errors[i]) std::rethrow_exception(errors[i]);
+}
+
+// fn is shared by the threads and called on each element exactly once
+template<class Container, class Function>
+void parallel_for_each(Container &c, Function fn, size_t threads = 0) {
+	parallel_prepare(c);
+	parallel_runs(c, parallel_threads(c.size(), parallel_limit(c, threads)), [&fn](size_t, typename parallel_iterator<Container>::type it, size_t count) {
+		for(; count > 1; --count, ++it) fn(*it);
+		fn(*it);
+	});
+}
+
+/**
+ * each thread folds its run in order starting from identity, acc = fold(acc, element),
+ * then the partial results are combined in rank order, result = combine(result, partial);
+ * so combine has to be associative with identity as its neutral element
+ */
+template<class Container, class Value, class Fold, class Combine>
+Value parallel_reduce(const Container &c, Value identity, Fold fold, Combine combine, size_t threads = 0) {
+	std::vector<Value> partial(parallel_threads(c.size(), parallel_limit(c, threads)), identity);
+	parallel_runs(c, partial.size(), [&](size_t i, typename parallel_iterator<const Container>::type it, size_t count) {
+		Value acc = identity; // neighbouring partials share cache lines
+		for(; count > 1; --count, ++it) acc = fold(acc, *it);
+		partial[i] = fold(acc, *it);
+	});
+	Value rtn = identity;
+	for(size_t i = 0; i < partial.size(); ++i) rtn = combine(rtn, partial[i]);
+	return rtn;
+}
+
+}
+
+#endif
@@ -1,101 +1,1050 @@
 #ifndef SJTU_PRIORITY_QUEUE_HPP
 #define SJTU_PRIORITY_QUEUE_HPP
 
+#include <atomic>
 #include <cstddef>
 #include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
 #include "exceptions.hpp"
+#include "stats.hpp"
+#include "utility.hpp"
 
 namespace sjtu {
 
-template<typename T, class Compare = std::less<T> >
+/**
+ * slab storage for the nodes of a pointer-based heap
+ * it hands out raw storage, callers construct and destroy the nodes themselves;
+ * released storage is chained through its first word and reused before a new slab is taken
+ */
+template<class Node>
+class node_pool {
+	struct slab {
+		slab *next;
+		Node *nodes;
+		slab(size_t n) : next(NULL), nodes((Node*)::operator new(n * sizeof(Node))) {}
+		~slab() {::operator delete(nodes);}
+	};
+	const static size_t SLAB_MIN = 4;
+	slab *slab_head, *slab_tail;
+	Node *unused_head, *unused_tail, *cursor, *limit;
+	size_t reserved, slabs;
+	
+	static Node *& link(Node *now) {return *reinterpret_cast<Node**>(now);}
+	void add_slab(size_t n) {
+		slab *now = new slab(n);
+		reserved += n, ++slabs;
+		if(slab_tail) slab_tail->next = now;
+		else slab_head = now;
+		slab_tail = now;
+		cursor = now->nodes;
+		limit = now->nodes + n;
+	}
+public:
+	node_pool() : slab_head(NULL), slab_tail(NULL), unused_head(NULL), unused_tail(NULL), cursor(NULL), limit(NULL),
+		reserved(0), slabs(0) {}
+	node_pool(const node_pool &other) = delete;
+	node_pool &operator=(const node_pool &other) = delete;
+	~node_pool() {clear();}
+	// storage for one node, a new slab holds about as many nodes as are in use
+	Node * allocate(size_t in_use) {
+		if(unused_head) {
+			Node *rtn = unused_head;
+			unused_head = link(rtn);
+			return rtn;
+		}
+		if(cursor == limit) add_slab(in_use < SLAB_MIN ? SLAB_MIN : in_use);
+		return cursor++;
+	}
+	// storage for n nodes in one contiguous slab
+	Node * allocate_block(size_t n) {
+		add_slab(n);
+		Node *rtn = cursor;
+		cursor = limit;
+		return rtn;
+	}
+	void release(Node *now) {
+		link(now) = unused_head;
+		if(!unused_head) unused_tail = now;
+		unused_head = now;
+	}
+	// take over every slab of other, nodes of both pools stay where they are
+	void splice(node_pool &other) {
+		if(this == &other) return;
+		if(other.slab_head) {
+			if(slab_tail) slab_tail->next = other.slab_head;
+			else slab_head = other.slab_head;
+			slab_tail = other.slab_tail;
+		}
+		if(other.unused_head) {
+			link(other.unused_tail) = unused_head;
+			if(!unused_head) unused_tail = other.unused_tail;
+			unused_head = other.unused_head;
+		}
+		reserved += other.reserved, slabs += other.slabs;
+		other.slab_head = other.slab_tail = NULL;
+		other.unused_head = other.unused_tail = other.cursor = other.limit = NULL;
+		other.reserved = other.slabs = 0;
+	}
+	// free every slab, nodes still in them must have been destroyed already
+	void clear() {
+		while(slab_head) {
+			slab *tmp = slab_head->next;
+			delete slab_head;
+			slab_head = tmp;
+		}
+		slab_tail = NULL;
+		unused_head = unused_tail = cursor = limit = NULL;
+		reserved = slabs = 0;
+	}
+	// every slab with its bookkeeping, used or not
+	size_t bytes() const {return reserved * sizeof(Node) + slabs * sizeof(slab);}
+};
+
+/**
+ * engine policies for priority_queue
+ * leftist_heap: pointer-based, O(log n) merge (default)
+ * dary_heap<D>: contiguous D-ary heap, allocation-free amortized push/pop, O(n) merge
+ * pairing_heap: pointer-based, O(1) push and merge, amortized O(log n) pop
+ * radix_heap: unsigned integer keys popped in ascending order (Compare = std::greater<T>);
+ *   a pushed key must not be smaller than the last popped one
+ * SJTU_PRIORITY_QUEUE_ENGINE changes the engine used when none is given
+ */
+struct leftist_heap {};
+template<size_t D = 4> struct dary_heap {};
+struct pairing_heap {};
+struct radix_heap {};
+
+#ifndef SJTU_PRIORITY_QUEUE_ENGINE
+#define SJTU_PRIORITY_QUEUE_ENGINE leftist_heap
+#endif
+
+/**
+ * the same counters for every engine: a spine is the merge path of a leftist heap
+ * or the child list a pairing heap combines on pop; allocations counts requests
+ * to the node pool (a whole batch or copy is one) or buffer growths
+ */
+struct priority_queue_statistics {
+	size_t merges = 0, spine_total = 0, spine_max = 0;
+	size_t allocations = 0;
+};
+
+template<typename T, class Compare = std::less<T>, class Engine = SJTU_PRIORITY_QUEUE_ENGINE>
 class priority_queue {
+public:
+	typedef priority_queue_statistics statistics;
+private:
 	struct node {
-		node *lson, *rson;
+		node *lson, *rson, *father;
 		T data;
 		int npl;
 		node(const T &_data, int _npl = 0, node *_lson = NULL, node *_rson = NULL) :
-			data(_data), npl(_npl), lson(_lson), rson(_rson) {
+			lson(_lson), rson(_rson), father(NULL), data(_data), npl(_npl) {
 			getNpl();	
 		}
 		void getNpl() {
 			if(rson == NULL) npl = 0;
 			else npl = rson->npl + 1;
 		}
-		static node * copy(const node *other) {
-			if(!other) return NULL;
-			else return new node(other->data, other->npl, copy(other->lson), copy(other->rson));
-		}
-		static void destroy(node *now) {
-			if(!now) return;
-			if(now->lson != NULL) destroy(now->lson);
-			if(now->rson != NULL) destroy(now->rson);
-			delete now;
-		}
 		static void swap(node *&x, node *&y) {
 			node *z = x;
 			x = y, y = z;
 		}
-		static node * merge(node *x, node *y) {
+		// the merge path is bounded by the two right spines, each at most log2(n + 1) long
+		const static size_t PATH = 2 * 8 * sizeof(size_t) + 2;
+		// restore the leftist property from now upwards, stop once npl no longer changes
+		static void fix(node *now) {
+			while(now) {
+				if(now->rson && (!now->lson || now->lson->npl < now->rson->npl)) swap(now->lson, now->rson);
+				int npl = now->npl;
+				now->getNpl();
+				if(now->npl == npl) return;
+				now = now->father;
+			}
+		}
+		static node * merge(node *x, node *y, size_t *spine = NULL) {
 			if(!x) return y;
 			else if(!y) return x;
 			Compare cmp;
-			if(cmp(x->data, y->data)) swap(x, y);
-			x->rson = merge(x->rson, y);
-			if(!x->lson || x->lson->npl < x->rson->npl) swap(x->lson, x->rson);
-			x->getNpl();
-			return x;
+			node *path[PATH], *rtn = NULL, **link = &rtn, *father = NULL;
+			size_t depth = 0;
+			while(x) {
+				if(cmp(x->data, y->data)) swap(x, y);
+				x->father = father;
+				*link = path[depth++] = x;
+				link = &x->rson;
+				father = x;
+				x = x->rson;
+			}
+			*link = y;
+			y->father = father;
+			if(spine) *spine = depth;
+			while(depth > 0) {
+				node *now = path[--depth];
+				if(!now->lson || now->lson->npl < now->rson->npl) swap(now->lson, now->rson);
+				now->getNpl();
+			}
+			return rtn;
 		}
 	};
+	/**
+	 * a copy borrows the nodes of the queue it was made from when share_on_copy<T>;
+	 * the lender keeps its nodes when it changes, so its handles stay valid, and leaves the
+	 * borrowers a copy, or its pool when it dies; a borrower copies them before its first change
+	 * the lender counts as a borrower until it changes or dies, so no copy ever frees a loan
+	 * lent still points to; copies of one unchanging queue may be made and destroyed on several
+	 * threads at once, the loan is set up with a CAS; changing a queue while it is copied is a race
+	 */
+	struct loan {
+		node *root;
+		node_pool<node> pool;
+		std::atomic<size_t> borrowers;
+		loan(node *_root) : root(_root), borrowers(1) {}
+	};
 	node *root;
 	int heapSize;
+	node_pool<node> pool;
+	mutable std::atomic<loan*> lent;
+	loan *borrowed;
+#if SJTU_STATS
+	statistics counters;
+	
+	node * meld(node *x, node *y) {
+		size_t spine = 0;
+		node *rtn = node::merge(x, y, &spine);
+		SJTU_COUNT(counters.merges, 1);
+		SJTU_COUNT(counters.spine_total, spine);
+		SJTU_COUNT_MAX(counters.spine_max, spine);
+		return rtn;
+	}
+#else
+	node * meld(node *x, node *y) {return node::merge(x, y);}
+#endif
+	
+	void release(node *now) {
+		now->~node();
+		pool.release(now);
+	}
+	static void destroy(node *now, node_pool<node> &pool) {
+		while(now) {
+			if(now->lson) {
+				node *tmp = now->lson;
+				now->lson = tmp->rson;
+				tmp->rson = now;
+				now = tmp;
+			} else {
+				node *tmp = now->rson;
+				now->~node();
+				now = tmp;
+			}
+		}
+		pool.clear();
+	}
+	void destroy() {
+		if(loan *now = lent.load()) {
+			now->pool.splice(pool);
+			lent = NULL;
+			give_back(now);
+		} else if(borrowed) {
+			give_back(borrowed);
+			borrowed = NULL;
+		} else destroy(root, pool);
+		root = NULL;
+		heapSize = 0;
+	}
+	// breadth-first copy of the n nodes below from into one slab, the slab itself serves as the queue;
+	// children still point into the original until their parent is processed
+	static node * clone(node_pool<node> &pool, const node *from, size_t n) {
+		node *block = pool.allocate_block(n), *tail = block;
+		new(tail++) node(from->data, from->npl, from->lson, from->rson);
+		for(node *now = block; now != tail; ++now) {
+			if(now->lson) {
+				new(tail) node(now->lson->data, now->lson->npl, now->lson->lson, now->lson->rson);
+				tail->father = now;
+				now->lson = tail++;
+			}
+			if(now->rson) {
+				new(tail) node(now->rson->data, now->rson->npl, now->rson->lson, now->rson->rson);
+				tail->father = now;
+				now->rson = tail++;
+			}
+		}
+		return block;
+	}
+	void copy(const priority_queue &other) {
+		if(other.heapSize == 0) return;
+		if(share_on_copy<T>::value) {
+			loan *now = other.borrowed ? other.borrowed : other.lent.load();
+			if(!now) {
+				loan *fresh = new loan(other.root);
+				if(other.lent.compare_exchange_strong(now, fresh)) now = fresh;
+				else delete fresh;
+			}
+			++now->borrowers;
+			borrowed = now;
+		} else {
+			SJTU_COUNT(counters.allocations, 1);
+			root = clone(pool, other.root, other.heapSize);
+		}
+		heapSize = other.heapSize;
+	}
+	// the last borrower to leave frees the nodes, the lender only leaves once it no longer reads them
+	static void give_back(loan *now) {
+		if(--now->borrowers > 0) return;
+		destroy(now->root, now->pool);
+		delete now;
+	}
+	// every change starts here, nodes read by others are copied for whoever does not own them
+	void own() {
+		if(loan *now = lent.load()) {
+			lent = NULL;
+			// nobody else borrows, and nobody can start while this queue changes
+			if(now->borrowers == 1) {
+				delete now;
+				return;
+			}
+			SJTU_COUNT(counters.allocations, 1);
+			now->root = clone(now->pool, root, heapSize);
+			give_back(now);
+		} else if(borrowed) {
+			loan *now = borrowed;
+			borrowed = NULL;
+			if(now->borrowers == 1) {
+				root = now->root;
+				pool.splice(now->pool);
+				delete now;
+			} else {
+				SJTU_COUNT(counters.allocations, 1);
+				root = clone(pool, now->root, heapSize);
+				give_back(now);
+			}
+		}
+	}
+	node * top_node() const {return borrowed ? borrowed->root : root;}
+	// replace now by its merged children, now keeps its data but leaves the heap
+	void detach(node *now) {
+		node *sub = meld(now->lson, now->rson), *father = now->father;
+		if(sub) sub->father = father;
+		if(!father) root = sub;
+		else {
+			if(father->lson == now) father->lson = sub;
+			else father->rson = sub;
+			node::fix(father);
+		}
+		now->lson = now->rson = now->father = NULL;
+		now->npl = 0;
+	}
+	// unlink the subtree rooted at now and merge it back from the root
+	void lift(node *now) {
+		node *father = now->father;
+		if(!father) return;
+		if(father->lson == now) father->lson = NULL;
+		else father->rson = NULL;
+		node::fix(father);
+		now->father = NULL;
+		root = meld(root, now);
+		root->father = NULL;
+	}
 public:
+	/**
+	 * a stable reference to an element, returned by push
+	 * it stays valid until the element is popped or erased, and follows the
+	 * element when its queue is merged into another one
+	 */
+	class handle {
+		friend class priority_queue;
+	private:
+		node *node_ptr;
+	public:
+		handle(node *_node_ptr = NULL) : node_ptr(_node_ptr) {}
+		const T & operator*() const {
+			SJTU_THROW_IF(node_ptr == NULL, invalid_iterator);
+			return node_ptr->data;
+		}
+		const T * operator->() const noexcept {return &node_ptr->data;}
+		bool operator==(const handle &rhs) const {return node_ptr == rhs.node_ptr;}
+		bool operator!=(const handle &rhs) const {return node_ptr != rhs.node_ptr;}
+	};
 	priority_queue() {
 		root = NULL;
 		heapSize = 0;
+		lent = NULL;
+		borrowed = NULL;
 	}
-	priority_queue(const priority_queue &other) {
-		root = node::copy(other.root);
-		heapSize = other.heapSize;
+	priority_queue(const priority_queue &other) : priority_queue() {
+		copy(other);
+	}
+	template<class ForwardIterator>
+	priority_queue(ForwardIterator first, ForwardIterator last) : priority_queue() {
+		push_range(first, last);
 	}
 	~priority_queue() {
-		node::destroy(root);
+		destroy();
+	}
+	priority_queue &operator=(const priority_queue &other) {
+		if(this == &other) return *this;
+		destroy();
+		copy(other);
+		return *this;
+	}
+	const T & top() const {
+		if(empty()) throw container_is_empty();
+		else return top_node()->data;
+	}
+	handle push(const T &e) {
+		own();
+		SJTU_COUNT(counters.allocations, 1);
+		node *now = new(pool.allocate(heapSize)) node(e);
+		root = meld(root, now);
+		root->father = NULL;
+		++heapSize;
+		return handle(now);
+	}
+	// O(n): the batch is built in one slab and merged pairwise as a queue of subtrees,
+	// which are chained through father while they wait
+	template<class ForwardIterator>
+	void push_range(ForwardIterator first, ForwardIterator last) {
+		size_t n = std::distance(first, last);
+		if(n == 0) return;
+		own();
+		SJTU_COUNT(counters.allocations, 1);
+		node *head = pool.allocate_block(n), *tail = head;
+		new(head) node(*first);
+		for(++first; first != last; ++first) {
+			node *now = tail + 1;
+			new(now) node(*first);
+			tail->father = now;
+			tail = now;
+		}
+		while(head != tail) {
+			node *x = head, *y = head->father;
+			head = y->father;
+			node *z = meld(x, y);
+			if(head) tail->father = z, tail = z;
+			else head = tail = z;
+		}
+		root = meld(root, head);
+		root->father = NULL;
+		heapSize += n;
+	}
+	void pop() {
+		if(empty()) throw container_is_empty();
+		own();
+		node *tmp = meld(root->lson, root->rson);
+		if(tmp) tmp->father = NULL;
+		release(root);
+		root = tmp;
+		--heapSize;
+	}
+	// move the top k elements to out in order and pop them
+	template<class OutputIterator>
+	OutputIterator pop_n(size_t k, OutputIterator out) {
+		if(k > size()) throw container_is_empty();
+		own();
+		for(; k > 0; --k) {
+			*out++ = std::move(root->data);
+			pop();
+		}
+		return out;
+	}
+	void pop_n(size_t k) {
+		if(k > size()) throw container_is_empty();
+		for(; k > 0; --k) pop();
+	}
+	// move every element to out in order, the queue ends up empty and frees its slabs
+	template<class OutputIterator>
+	OutputIterator drain_sorted(OutputIterator out) {
+		out = pop_n(size(), out);
+		destroy();
+		return out;
+	}
+	void modify(handle pos, const T &value) {
+		SJTU_THROW_IF(pos.node_ptr == NULL, invalid_iterator);
+		own();
+		node *now = pos.node_ptr;
+		Compare cmp;
+		if(cmp(value, now->data)) {
+			detach(now);
+			now->data = value;
+			root = meld(root, now);
+			root->father = NULL;
+		} else {
+			now->data = value;
+			if(now->father && cmp(now->father->data, now->data)) lift(now);
+		}
+	}
+	// value must not rank below the current one, e.g. a shorter distance under std::greater
+	void decrease_key(handle pos, const T &value) {
+		SJTU_THROW_IF(pos.node_ptr == NULL, invalid_iterator);
+		Compare cmp;
+		if(cmp(value, pos.node_ptr->data)) throw runtime_error();
+		own();
+		pos.node_ptr->data = value;
+		if(pos.node_ptr->father && cmp(pos.node_ptr->father->data, value)) lift(pos.node_ptr);
+	}
+	void erase(handle pos) {
+		SJTU_THROW_IF(pos.node_ptr == NULL, invalid_iterator);
+		own();
+		detach(pos.node_ptr);
+		release(pos.node_ptr);
+		--heapSize;
+	}
+	size_t size() const {
+		return heapSize;
+	}
+	bool empty() const {
+		return heapSize == 0;
+	}
+	// free slots left in the slabs count as overhead, a borrower counts the nodes it reads
+	memory_footprint memory_usage() const {
+		size_t bytes = borrowed ? heapSize * sizeof(node) : pool.bytes();
+		return memory_footprint(heapSize, sizeof(T), heapSize, sizeof(priority_queue) + bytes);
+	}
+#if SJTU_STATS
+	statistics stats() const {return counters;}
+	void reset_stats() {counters = statistics();}
+#else
+	statistics stats() const {return statistics();}
+	void reset_stats() {}
+#endif
+	void merge(priority_queue &other) {
+		if(this == &other) return;
+		own();
+		other.own();
+		root = meld(root, other.root);
+		if(root) root->father = NULL;
+		heapSize = heapSize + other.heapSize;
+		pool.splice(other.pool);
+		other.root = NULL;
+		other.heapSize = 0;
+	}
+};
+
+template<typename T, class Compare, size_t D>
+class priority_queue<T, Compare, dary_heap<D> > {
+public:
+	typedef priority_queue_statistics statistics;
+private:
+	// the root lives at data[D - 1] so every group of siblings starts on a multiple of D,
+	// with an aligned buffer each group shares one cache line when D * sizeof(T) <= ALIGN
+	const static size_t ALIGN = 64;
+	const static size_t SHIFT = D - 1;
+	char *buffer;
+	T *data;
+	size_t heapSize, capacity;
+	Compare cmp;
+#if SJTU_STATS
+	statistics counters;
+#endif
+	
+	T & slot(size_t k) {return data[k + SHIFT];}
+	const T & slot(size_t k) const {return data[k + SHIFT];}
+	void reallocate(size_t n) {
+		SJTU_COUNT(counters.allocations, 1);
+		char *new_buffer = new char[(n + SHIFT) * sizeof(T) + ALIGN];
+		T *new_data = (T*)(new_buffer + (ALIGN - (size_t)new_buffer % ALIGN) % ALIGN);
+		for(size_t i = 0; i < heapSize; ++i) {
+			new(new_data + i + SHIFT) T(std::move(slot(i)));
+			slot(i).~T();
+		}
+		delete [] buffer;
+		buffer = new_buffer;
+		data = new_data;
+		capacity = n;
+	}
+	void destroy() {
+		for(size_t i = 0; i < heapSize; ++i) slot(i).~T();
+		delete [] buffer;
+		buffer = NULL;
+		data = NULL;
+		heapSize = capacity = 0;
+	}
+	void copy(const priority_queue &other) {
+		reallocate(other.heapSize);
+		for(size_t i = 0; i < other.heapSize; ++i) new(&slot(i)) T(other.slot(i));
+		heapSize = other.heapSize;
+	}
+	// slot k holds no object, move the one at from into it
+	void relocate(size_t k, size_t from) {
+		new(&slot(k)) T(std::move(slot(from)));
+		slot(from).~T();
+	}
+	// the sifts move an empty slot through the heap and construct value where it stops,
+	// so T only has to be copy or move constructible
+	template<class V>
+	void sift_up(size_t k, V &&value) {
+		while(k > 0) {
+			size_t parent = (k - 1) / D;
+			if(!cmp(slot(parent), value)) break;
+			relocate(k, parent);
+			k = parent;
+		}
+		new(&slot(k)) T(std::forward<V>(value));
+	}
+	template<class V>
+	void sift_down(size_t k, V &&value) {
+		for(size_t first = k * D + 1; first < heapSize; first = k * D + 1) {
+			size_t last = first + D < heapSize ? first + D : heapSize, best = first;
+			for(size_t i = first + 1; i < last; ++i)
+				if(cmp(slot(best), slot(i))) best = i;
+			if(!cmp(value, slot(best))) break;
+			relocate(k, best);
+			k = best;
+		}
+		new(&slot(k)) T(std::forward<V>(value));
+	}
+	// Floyd's bottom-up construction, O(n)
+	void heapify() {
+		for(size_t i = heapSize / D + 1; i-- > 0; ) {
+			if(i >= heapSize) continue;
+			T value(std::move(slot(i)));
+			slot(i).~T();
+			sift_down(i, std::move(value));
+		}
 	}
+public:
+	priority_queue() : buffer(NULL), data(NULL), heapSize(0), capacity(0) {}
+	priority_queue(const priority_queue &other) : priority_queue() {copy(other);}
+	template<class ForwardIterator>
+	priority_queue(ForwardIterator first, ForwardIterator last) : priority_queue() {push_range(first, last);}
+	~priority_queue() {destroy();}
 	priority_queue &operator=(const priority_queue &other) {
 		if(this == &other) return *this;
-		node::destroy(root);
-		root = node::copy(other.root);
+		destroy();
+		copy(other);
+		return *this;
+	}
+	const T & top() const {
+		if(empty()) throw container_is_empty();
+		return slot(0);
+	}
+	void push(const T &e) {
+		T value(e);
+		if(heapSize == capacity) reallocate(capacity ? capacity * 2 : 16);
+		sift_up(heapSize++, std::move(value));
+	}
+	// a batch at least as large as the heap is rebuilt bottom-up, a smaller one sifted up
+	template<class ForwardIterator>
+	void push_range(ForwardIterator first, ForwardIterator last) {
+		size_t n = std::distance(first, last), old = heapSize;
+		if(n == 0) return;
+		reserve(heapSize + n);
+		if(n >= old) {
+			for(; first != last; ++first) new(&slot(heapSize++)) T(*first);
+			heapify();
+		} else for(; first != last; ++first) sift_up(heapSize++, *first);
+	}
+	void pop() {
+		if(empty()) throw container_is_empty();
+		slot(0).~T();
+		if(--heapSize > 0) {
+			T value(std::move(slot(heapSize)));
+			slot(heapSize).~T();
+			sift_down(0, std::move(value));
+		}
+	}
+	template<class OutputIterator>
+	OutputIterator pop_n(size_t k, OutputIterator out) {
+		if(k > size()) throw container_is_empty();
+		for(; k > 0; --k) {
+			*out++ = std::move(slot(0));
+			pop();
+		}
+		return out;
+	}
+	void pop_n(size_t k) {
+		if(k > size()) throw container_is_empty();
+		for(; k > 0; --k) pop();
+	}
+	template<class OutputIterator>
+	OutputIterator drain_sorted(OutputIterator out) {
+		out = pop_n(size(), out);
+		destroy();
+		return out;
+	}
+	size_t size() const {
+		return heapSize;
+	}
+	bool empty() const {
+		return heapSize == 0;
+	}
+	memory_footprint memory_usage() const {
+		size_t bytes = buffer ? (capacity + SHIFT) * sizeof(T) + ALIGN : 0;
+		return memory_footprint(heapSize, sizeof(T), 0, sizeof(priority_queue) + bytes);
+	}
+#if SJTU_STATS
+	statistics stats() const {return counters;}
+	void reset_stats() {counters = statistics();}
+#else
+	statistics stats() const {return statistics();}
+	void reset_stats() {}
+#endif
+	void reserve(size_t n) {
+		if(n > capacity) reallocate(n);
+	}
+	void merge(priority_queue &other) {
+		if(this == &other) return;
+		reserve(heapSize + other.heapSize);
+		SJTU_COUNT(counters.merges, 1);
+		for(size_t i = 0; i < other.heapSize; ++i) new(&slot(heapSize + i)) T(std::move(other.slot(i)));
+		heapSize += other.heapSize;
+		other.destroy();
+		heapify();
+	}
+};
+
+
+template<typename T, class Compare>
+class priority_queue<T, Compare, pairing_heap> {
+public:
+	typedef priority_queue_statistics statistics;
+private:
+	// children of a node form a list through sibling
+	struct node {
+		node *child, *sibling;
+		T data;
+		node(const T &_data, node *_child = NULL, node *_sibling = NULL) :
+			child(_child), sibling(_sibling), data(_data) {}
+	};
+	node *root;
+	size_t heapSize;
+	node_pool<node> pool;
+#if SJTU_STATS
+	statistics counters;
+#endif
+	
+	static node * meld(node *x, node *y) {
+		if(!x) return y;
+		else if(!y) return x;
+		Compare cmp;
+		if(cmp(x->data, y->data)) {
+			node *z = x;
+			x = y, y = z;
+		}
+		y->sibling = x->child;
+		x->child = y;
+		return x;
+	}
+	// two-pass pairing: meld neighbours left to right, then fold the pairs right to left
+	node * combine(node *first) {
+		node *pairs = NULL;
+		size_t spine = 0;
+		while(first) {
+			++spine;
+			node *x = first, *y = first->sibling;
+			first = y ? y->sibling : NULL;
+			x->sibling = NULL;
+			if(y) y->sibling = NULL;
+			x = meld(x, y);
+			x->sibling = pairs;
+			pairs = x;
+		}
+		SJTU_COUNT(counters.merges, spine);
+		SJTU_COUNT(counters.spine_total, spine);
+		SJTU_COUNT_MAX(counters.spine_max, spine);
+		node *rtn = NULL;
+		while(pairs) {
+			node *x = pairs;
+			pairs = pairs->sibling;
+			x->sibling = NULL;
+			rtn = meld(x, rtn);
+		}
+		return rtn;
+	}
+	void destroy() {
+		node *now = root;
+		while(now) {
+			if(now->child) {
+				node *tmp = now->child;
+				now->child = tmp->sibling;
+				tmp->sibling = now;
+				now = tmp;
+			} else {
+				node *tmp = now->sibling;
+				now->~node();
+				now = tmp;
+			}
+		}
+		pool.clear();
+		root = NULL;
+		heapSize = 0;
+	}
+	// breadth-first copy into one slab, as in the leftist heap
+	void copy(const priority_queue &other) {
+		if(!other.root) return;
+		SJTU_COUNT(counters.allocations, 1);
+		node *block = pool.allocate_block(other.heapSize), *tail = block;
+		new(tail++) node(other.root->data, other.root->child);
+		for(node *now = block; now != tail; ++now) {
+			if(now->child) {
+				new(tail) node(now->child->data, now->child->child, now->child->sibling);
+				now->child = tail++;
+			}
+			if(now->sibling) {
+				new(tail) node(now->sibling->data, now->sibling->child, now->sibling->sibling);
+				now->sibling = tail++;
+			}
+		}
+		root = block;
 		heapSize = other.heapSize;
+	}
+public:
+	priority_queue() : root(NULL), heapSize(0) {}
+	priority_queue(const priority_queue &other) : priority_queue() {copy(other);}
+	template<class ForwardIterator>
+	priority_queue(ForwardIterator first, ForwardIterator last) : priority_queue() {push_range(first, last);}
+	~priority_queue() {destroy();}
+	priority_queue &operator=(const priority_queue &other) {
+		if(this == &other) return *this;
+		destroy();
+		copy(other);
 		return *this;
 	}
 	const T & top() const {
 		if(empty()) throw container_is_empty();
-		else return root->data;
+		return root->data;
 	}
 	void push(const T &e) {
-		node *now = new node(e);
-		root = node::merge(root, now);
+		SJTU_COUNT(counters.merges, 1);
+		SJTU_COUNT(counters.allocations, 1);
+		root = meld(root, new(pool.allocate(heapSize)) node(e));
 		++heapSize;
 	}
+	// O(n): the batch is built in one slab as a sibling list, which two-pass pairing turns into a heap
+	template<class ForwardIterator>
+	void push_range(ForwardIterator first, ForwardIterator last) {
+		size_t n = std::distance(first, last);
+		if(n == 0) return;
+		SJTU_COUNT(counters.allocations, 1);
+		node *block = pool.allocate_block(n);
+		for(size_t i = 0; first != last; ++first, ++i) new(block + i) node(*first, NULL, i + 1 < n ? block + i + 1 : NULL);
+		SJTU_COUNT(counters.merges, 1);
+		root = meld(root, combine(block));
+		heapSize += n;
+	}
 	void pop() {
 		if(empty()) throw container_is_empty();
-		node *tmp = node::merge(root->lson, root->rson);
-		delete root;
+		node *tmp = combine(root->child);
+		root->~node();
+		pool.release(root);
 		root = tmp;
 		--heapSize;
 	}
+	// move the top k elements to out in order and pop them
+	template<class OutputIterator>
+	OutputIterator pop_n(size_t k, OutputIterator out) {
+		if(k > size()) throw container_is_empty();
+		for(; k > 0; --k) {
+			*out++ = std::move(root->data);
+			pop();
+		}
+		return out;
+	}
+	void pop_n(size_t k) {
+		if(k > size()) throw container_is_empty();
+		for(; k > 0; --k) pop();
+	}
+	// move every element to out in order, the queue ends up empty and frees its slabs
+	template<class OutputIterator>
+	OutputIterator drain_sorted(OutputIterator out) {
+		out = pop_n(size(), out);
+		destroy();
+		return out;
+	}
 	size_t size() const {
 		return heapSize;
 	}
 	bool empty() const {
 		return root == NULL;
 	}
+	// free slots left in the slabs count as overhead
+	memory_footprint memory_usage() const {
+		return memory_footprint(heapSize, sizeof(T), heapSize, sizeof(priority_queue) + pool.bytes());
+	}
+#if SJTU_STATS
+	statistics stats() const {return counters;}
+	void reset_stats() {counters = statistics();}
+#else
+	statistics stats() const {return statistics();}
+	void reset_stats() {}
+#endif
 	void merge(priority_queue &other) {
-		root = node::merge(root, other.root);
-		heapSize = heapSize + other.heapSize;
+		if(this == &other) return;
+		SJTU_COUNT(counters.merges, 1);
+		root = meld(root, other.root);
+		heapSize += other.heapSize;
+		pool.splice(other.pool);
 		other.root = NULL;
 		other.heapSize = 0;
 	}
 };
 
+template<typename T, class Compare>
+class priority_queue<T, Compare, radix_heap> {
+public:
+	typedef priority_queue_statistics statistics;
+private:
+	static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value, "radix_heap needs unsigned integer keys");
+	static_assert(std::is_same<Compare, std::greater<T> >::value, "radix_heap pops the smallest key, use std::greater<T>");
+	
+	const static size_t BITS = 8 * sizeof(T);
+	struct bucket {
+		T *data;
+		size_t size, capacity;
+		bucket() : data(NULL), size(0), capacity(0) {}
+		bucket(const bucket &other) : data(NULL), size(0), capacity(0) {*this = other;}
+		~bucket() {delete [] data;}
+		bucket &operator=(const bucket &other) {
+			if(this == &other) return *this;
+			if(capacity < other.size) {
+				delete [] data;
+				data = new T[other.size];
+				capacity = other.size;
+			}
+			for(size_t i = 0; i < other.size; ++i) data[i] = other.data[i];
+			size = other.size;
+			return *this;
+		}
+		void push_back(const T &x) {
+			if(size == capacity) {
+				size_t n = capacity ? capacity * 2 : 8;
+				T *tmp = new T[n];
+				for(size_t i = 0; i < size; ++i) tmp[i] = data[i];
+				delete [] data;
+				data = tmp;
+				capacity = n;
+			}
+			data[size++] = x;
+		}
+	};
+	// bucket i > 0 holds the keys whose highest bit differing from last is bit i - 1
+	bucket buckets[BITS + 1];
+	T last;
+	size_t heapSize;
+	mutable T minimum;
+	mutable bool minimum_valid;
+#if SJTU_STATS
+	statistics counters;
+#endif
+	
+	void append(bucket &now, const T &x) {
+		SJTU_COUNT(counters.allocations, now.size == now.capacity);
+		now.push_back(x);
+	}
+	static size_t index(const T &x, const T &last) {
+		if(x == last) return 0;
+#ifdef __GNUC__
+		return 8 * sizeof(unsigned long long) - __builtin_clzll((unsigned long long)(x ^ last));
+#else
+		size_t rtn = 0;
+		for(T diff = x ^ last; diff; diff >>= 1) ++rtn;
+		return rtn;
+#endif
+	}
+	size_t first_bucket() const {
+		size_t i = 0;
+		while(buckets[i].size == 0) ++i;
+		return i;
+	}
+	// redistribute the lowest non-empty bucket around its smallest key, which becomes last
+	void refill() {
+		bucket &now = buckets[first_bucket()];
+		T low = now.data[0];
+		for(size_t i = 1; i < now.size; ++i) if(now.data[i] < low) low = now.data[i];
+		last = low;
+		for(size_t i = 0; i < now.size; ++i) append(buckets[index(now.data[i], last)], now.data[i]);
+		now.size = 0;
+	}
+public:
+	priority_queue() : last(0), heapSize(0), minimum(0), minimum_valid(false) {}
+	priority_queue(const priority_queue &other) = default;
+	template<class ForwardIterator>
+	priority_queue(ForwardIterator first, ForwardIterator last) : priority_queue() {push_range(first, last);}
+	priority_queue &operator=(const priority_queue &other) = default;
+	const T & top() const {
+		if(empty()) throw container_is_empty();
+		if(buckets[0].size) return last;
+		if(!minimum_valid) {
+			const bucket &now = buckets[first_bucket()];
+			minimum = now.data[0];
+			for(size_t i = 1; i < now.size; ++i) if(now.data[i] < minimum) minimum = now.data[i];
+			minimum_valid = true;
+		}
+		return minimum;
+	}
+	void push(const T &e) {
+		if(e < last) throw runtime_error();
+		append(buckets[index(e, last)], e);
+		if(minimum_valid && e < minimum) minimum = e;
+		++heapSize;
+	}
+	// keys go to their buckets one by one, there is no heap order to build
+	template<class ForwardIterator>
+	void push_range(ForwardIterator first, ForwardIterator last) {
+		for(; first != last; ++first) push(*first);
+	}
+	void pop() {
+		if(empty()) throw container_is_empty();
+		if(buckets[0].size == 0) refill();
+		--buckets[0].size;
+		--heapSize;
+		minimum_valid = false;
+	}
+	template<class OutputIterator>
+	OutputIterator pop_n(size_t k, OutputIterator out) {
+		if(k > size()) throw container_is_empty();
+		for(; k > 0; --k) {
+			*out++ = top();
+			pop();
+		}
+		return out;
+	}
+	void pop_n(size_t k) {
+		if(k > size()) throw container_is_empty();
+		for(; k > 0; --k) pop();
+	}
+	// the buckets are freed once drained
+	template<class OutputIterator>
+	OutputIterator drain_sorted(OutputIterator out) {
+		out = pop_n(size(), out);
+		for(size_t i = 0; i <= BITS; ++i) {
+			delete [] buckets[i].data;
+			buckets[i].data = NULL;
+			buckets[i].capacity = 0;
+		}
+		return out;
+	}
+	size_t size() const {
+		return heapSize;
+	}
+	bool empty() const {
+		return heapSize == 0;
+	}
+	memory_footprint memory_usage() const {
+		size_t bytes = sizeof(priority_queue);
+		for(size_t i = 0; i <= BITS; ++i) bytes += buckets[i].capacity * sizeof(T);
+		return memory_footprint(heapSize, sizeof(T), 0, bytes);
+	}
+#if SJTU_STATS
+	statistics stats() const {return counters;}
+	void reset_stats() {counters = statistics();}
+#else
+	statistics stats() const {return statistics();}
+	void reset_stats() {}
+#endif
+	void merge(priority_queue &other) {
+		if(this == &other || other.empty()) return;
+		if(other.top() < last) throw runtime_error();
+		for(size_t i = 0; i <= BITS; ++i) {
+			for(size_t j = 0; j < other.buckets[i].size; ++j) push(other.buckets[i].data[j]);
+			other.buckets[i].size = 0;
+		}
+		other.heapSize = 0;
+		other.minimum_valid = false;
+	}
+};
+
 }
 #endif
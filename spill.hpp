@@ -0,0 +1,191 @@
+#ifndef SJTU_SPILL_HPP
+#define SJTU_SPILL_HPP
+
+#include "exceptions.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * SJTU_SPILL = 1 where temp files can be mapped (posix), deque::spill() throws
+ * runtime_error elsewhere
+ */
+#ifndef SJTU_SPILL
+#if defined(__unix__) || defined(__APPLE__)
+#define SJTU_SPILL 1
+#else
+#define SJTU_SPILL 0
+#endif
+#endif
+
+#if SJTU_SPILL
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace sjtu {
+
+/**
+ * an unlinked temp file cut into page aligned slots of equal size, one per spilled block;
+ * a slot is written and read whole, or mapped to be worked on in place; freed slots are
+ * reused before the file grows, it is gone once the last of its users drops it
+ * at most MAPPINGS slots are mapped at a time: every mapping gets a ticket, and making one
+ * the newest unmaps the oldest, so the memory and the map count of a scan stay bounded
+ * not thread safe, a spilling container and its copies stay on one thread
+ */
+class spill_file {
+public:
+	const static size_t MAPPINGS = 16;
+private:
+	struct mapping {
+		size_t ticket;
+		void *address;
+	};
+	int fd;
+	size_t bytes, slots, top, used;
+	size_t *free_slots, free_count, free_capacity;
+	mapping ring[MAPPINGS];
+	size_t tickets;
+	std::atomic<size_t> refs;
+
+	~spill_file() {
+#if SJTU_SPILL
+		for(size_t i = 0; i < MAPPINGS; ++i) if(ring[i].ticket != 0) munmap(ring[i].address, bytes);
+		close(fd);
+#endif
+		delete [] free_slots;
+	}
+	size_t offset(size_t slot) const {return slot * bytes;}
+public:
+	// dir NULL takes $TMPDIR or /tmp; slot_bytes is rounded up to whole pages
+	spill_file(const char *dir, size_t slot_bytes) :
+		fd(-1), bytes(slot_bytes), slots(0), top(0), used(0), free_slots(NULL), free_count(0), free_capacity(0),
+		tickets(0), refs(1) {
+		for(size_t i = 0; i < MAPPINGS; ++i) ring[i].ticket = 0;
+#if SJTU_SPILL
+		if(dir == NULL) dir = getenv("TMPDIR");
+		if(dir == NULL || *dir == '\0') dir = "/tmp";
+		size_t page = sysconf(_SC_PAGESIZE);
+		bytes = (slot_bytes + page - 1) / page * page;
+		size_t length = strlen(dir);
+		char *path = new char[length + 20];
+		memcpy(path, dir, length);
+		memcpy(path + length, "/sjtu-spill-XXXXXX", 19);
+		fd = mkstemp(path);
+		if(fd >= 0) unlink(path);
+		delete [] path;
+		if(fd < 0) throw runtime_error("cannot create spill file");
+#else
+		throw runtime_error("spilling needs posix");
+#endif
+	}
+	spill_file(const spill_file &) = delete;
+	spill_file &operator=(const spill_file &) = delete;
+	void retain() {++refs;}
+	void drop() {if(--refs == 0) delete this;}
+	size_t slot_bytes() const {return bytes;}
+	// slots holding data, and the file's size
+	size_t slots_used() const {return used;}
+	size_t file_bytes() const {return slots * bytes;}
+
+	size_t take() {
+		if(free_count > 0) {
+			++used;
+			return free_slots[--free_count];
+		}
+#if SJTU_SPILL
+		if(top == slots) {
+			size_t grown = slots < 16 ? 16 : slots * 2;
+			if(ftruncate(fd, (off_t)offset(grown)) != 0) throw runtime_error("cannot grow spill file");
+			slots = grown;
+		}
+#endif
+		++used;
+		return top++;
+	}
+	// the slot's mapping under ticket goes too, if it is still there
+	void release(size_t slot, size_t ticket) {
+		if(mapped(ticket)) {
+#if SJTU_SPILL
+			munmap(ring[ticket % MAPPINGS].address, bytes);
+#endif
+			ring[ticket % MAPPINGS].ticket = 0;
+		}
+		if(free_count == free_capacity) {
+			size_t capacity = free_capacity < 16 ? 16 : free_capacity * 2;
+			size_t *grown = new size_t[capacity];
+			if(free_count > 0) memcpy(grown, free_slots, free_count * sizeof(size_t));
+			delete [] free_slots;
+			free_slots = grown;
+			free_capacity = capacity;
+		}
+		free_slots[free_count++] = slot;
+		--used;
+	}
+	void write(size_t slot, const void *source, size_t n) {
+#if SJTU_SPILL
+		const char *from = static_cast<const char*>(source);
+		for(size_t done = 0; done < n; ) {
+			ssize_t step = pwrite(fd, from + done, n - done, (off_t)(offset(slot) + done));
+			if(step <= 0) throw runtime_error("cannot write spill file");
+			done += step;
+		}
+#endif
+	}
+	void read(size_t slot, void *target, size_t n) {
+#if SJTU_SPILL
+		char *to = static_cast<char*>(target);
+		for(size_t done = 0; done < n; ) {
+			ssize_t step = pread(fd, to + done, n - done, (off_t)(offset(slot) + done));
+			if(step <= 0) throw runtime_error("cannot read spill file");
+			done += step;
+		}
+#endif
+	}
+	// 0 is never a ticket
+	bool mapped(size_t ticket) const {return ticket != 0 && ring[ticket % MAPPINGS].ticket == ticket;}
+	size_t newest() const {return tickets;}
+	/**
+	 * make the slot's mapping the newest one, mapping it again unless ticket still holds it,
+	 * and give it a new ticket; writes through a mapping land in the file
+	 * current is the address ticket was given for
+	 */
+	void * map(size_t slot, size_t &ticket, void *current) {
+		void *rtn = NULL;
+		if(mapped(ticket)) {
+			rtn = current;
+			ring[ticket % MAPPINGS].ticket = 0;
+		}
+		size_t fresh = ++tickets;
+		mapping &now = ring[fresh % MAPPINGS];
+#if SJTU_SPILL
+		if(now.ticket != 0) munmap(now.address, bytes);
+		now.ticket = 0;
+		ticket = 0;
+		if(rtn == NULL) {
+			rtn = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t)offset(slot));
+			if(rtn == MAP_FAILED) throw runtime_error("cannot map spill file");
+		}
+#else
+		(void)slot;
+#endif
+		now.ticket = fresh;
+		now.address = rtn;
+		ticket = fresh;
+		return rtn;
+	}
+	// start reading the slot into the page cache without waiting for it
+	void prefetch(size_t slot) {
+#if SJTU_SPILL && defined(POSIX_FADV_WILLNEED)
+		posix_fadvise(fd, (off_t)offset(slot), (off_t)bytes, POSIX_FADV_WILLNEED);
+#else
+		(void)slot;
+#endif
+	}
+};
+
+}
+
+#endif
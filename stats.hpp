@@ -0,0 +1,40 @@
+#ifndef SJTU_STATS_HPP
+#define SJTU_STATS_HPP
+
+#include <cstddef>
+
+/**
+ * SJTU_STATS = 1 makes the containers count their internal work into a statistics
+ * struct, read by stats() and cleared by reset_stats(); by default the counters and
+ * the code updating them are compiled out and stats() returns zeros
+ */
+#ifndef SJTU_STATS
+#define SJTU_STATS 0
+#endif
+
+#if SJTU_STATS
+#define SJTU_COUNT(counter, amount) ((void)((counter) += (amount)))
+#define SJTU_COUNT_MAX(counter, value) ((void)((counter) < (value) ? (counter) = (value) : 0))
+#else
+#define SJTU_COUNT(counter, amount) ((void)0)
+#define SJTU_COUNT_MAX(counter, value) ((void)0)
+#endif
+
+namespace sjtu {
+
+/**
+ * what memory_usage() reports: bytes covers the container object and everything it
+ * allocated, allocator bookkeeping excluded; nodes counts list, tree or heap nodes;
+ * overhead is every byte beyond sizeof(element) per element
+ */
+struct memory_footprint {
+	size_t elements, nodes, bytes;
+	double overhead_per_element;
+	memory_footprint(size_t _elements = 0, size_t element_size = 0, size_t _nodes = 0, size_t _bytes = 0) :
+		elements(_elements), nodes(_nodes), bytes(_bytes),
+		overhead_per_element(_elements ? ((double)_bytes - (double)_elements * element_size) / _elements : 0) {}
+};
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ * merge spreads a queue over the shards: relaxed pops right after a large merge still come
+ * from near the top, and merges racing with pushes and pops lose nothing; run under the
+ * thread sanitizer
+ */
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "../concurrent_priority_queue.hpp"
+
+typedef sjtu::concurrent_priority_queue<int> queue_type;
+
+int main() {
+	// every popped element is within a few shards' worth of ranks of the best one left
+	queue_type q(16);
+	for(int i = 0; i < 1000; ++i) q.push(i);
+	queue_type::queue_type big;
+	for(int i = 0; i < 100000; ++i) big.push(1000 + i);
+	q.merge(big);
+	assert(big.empty() && q.size() == 101000);
+	int best = 100999;
+	std::vector<bool> gone(101000);
+	for(int i = 0; i < 10000; ++i) {
+		int x = q.pop();
+		gone[x] = true;
+		while(gone[best]) --best;
+		assert(best - x < 16 * 16);
+	}
+
+	// merges on some threads, pushes and pops on others
+	queue_type shared(8);
+	std::vector<std::thread> threads;
+	std::vector<long long> popped(4);
+	for(int t = 0; t < 4; ++t) threads.emplace_back([&shared, &popped, t]() {
+		for(int round = 0; round < 50; ++round) {
+			if(t % 2 == 0) {
+				queue_type::queue_type part;
+				for(int i = 0; i < 100; ++i) part.push(i);
+				shared.merge(part);
+			} else for(int i = 0; i < 100; ++i) shared.push(i);
+			for(int i = 0; i < 50; ++i) {
+				int x;
+				if(shared.try_pop(x)) popped[t] += x + 1;
+			}
+		}
+	});
+	for(size_t t = 0; t < threads.size(); ++t) threads[t].join();
+	long long total = 0;
+	for(int t = 0; t < 4; ++t) total += popped[t];
+	for(int x; shared.try_pop(x); ) total += x + 1;
+	assert(total == 4LL * 50 * 5050 && shared.empty());
+	puts("ok");
+	return 0;
+}
@@ -0,0 +1,57 @@
+/**
+ * a copy of a deque is a separate value: references, pointers and iterators taken into
+ * either deque before the copy keep pointing into that deque, whatever happens to the other
+ */
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include "../deque.hpp"
+
+struct shared_string {
+	std::string s;
+	shared_string(const char *_s) : s(_s) {}
+};
+namespace sjtu {
+template<> struct share_on_copy<shared_string> : std::true_type {};
+}
+
+int main() {
+	sjtu::deque<int> a;
+	for(int i = 0; i < 10000; ++i) a.push_back(i);
+
+	// a mutable reference written after the copy changes only the original
+	int &r = a[0];
+	sjtu::deque<int> c(a);
+	r = 42;
+	assert(a[0] == 42 && c[0] == 0);
+	int *p = &a.at(5);
+	sjtu::deque<int> d(a);
+	*p = 7;
+	assert(a[5] == 7 && d[5] == 5);
+
+	// a const reference keeps reading the original once the copy is gone
+	sjtu::deque<int> e(a);
+	const int &cr = e.front();
+	{
+		sjtu::deque<int> f(e);
+		e[0] = 9;
+		assert(f[0] == 42);
+	}
+	assert(cr == 9);
+
+	// assignment, iterators into both sides
+	sjtu::deque<int> g;
+	g = a;
+	sjtu::deque<int>::iterator it = a.begin() + 100;
+	*it = -1;
+	assert(g[100] == 100 && a[100] == -1);
+
+	// types that opt in are shared, and still compare as separate values once changed
+	sjtu::deque<shared_string> s;
+	for(int i = 0; i < 5000; ++i) s.push_back("x");
+	sjtu::deque<shared_string> t(s);
+	s[10] = "y";
+	assert(t[10].s == "x" && s[10].s == "y");
+	puts("ok");
+	return 0;
+}
@@ -0,0 +1,45 @@
+/**
+ * a spilling deque maps only a few of its spilled blocks at a time: a read-only scan over
+ * more blocks than vm.max_map_count allows mappings neither runs out of them nor fails
+ */
+#include <cassert>
+#include <cstdio>
+#include "../deque.hpp"
+#include "../parallel.hpp"
+
+static size_t max_map_count() {
+	size_t rtn = 65530;
+	FILE *f = fopen("/proc/sys/vm/max_map_count", "r");
+	if(f != NULL) {
+		if(fscanf(f, "%zu", &rtn) != 1) rtn = 65530;
+		fclose(f);
+	}
+	return rtn;
+}
+
+int main() {
+	// blocks filled by push_back hold at least BUFF_SIZE_LOW elements
+	size_t blocks = max_map_count() + 1000, n = blocks * 1024;
+	sjtu::deque<char> d;
+	d.spill(1 << 16);
+	unsigned long long expected = 0;
+	for(size_t i = 0; i < n; ++i) {
+		d.push_back((char)(i % 251));
+		expected += i % 251;
+	}
+
+	const sjtu::deque<char> &c = d;
+	unsigned long long sum = 0;
+	for(sjtu::deque<char>::const_iterator it = c.cbegin(); it != c.cend(); ++it) sum += (unsigned char)*it;
+	assert(sum == expected);
+	sum = sjtu::parallel_reduce(c, 0ULL, [](unsigned long long acc, char x) {return acc + (unsigned char)x;},
+		[](unsigned long long a, unsigned long long b) {return a + b;});
+	assert(sum == expected);
+
+	// writes through iterators land in the file and survive being unmapped
+	for(size_t i = 0; i < n; i += 4096) *(d.begin() + i) = 0;
+	for(size_t i = 0; i < n; i += 4096) assert(c[i] == 0);
+	assert(c[1] == 1 % 251 && c[n - 1] == (char)((n - 1) % 251));
+	printf("spill scan ok\n");
+	return 0;
+}
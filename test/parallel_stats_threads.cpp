@@ -0,0 +1,30 @@
+/**
+ * parallel scans of a map and a deque with the statistics compiled in: counting is a write,
+ * so the runs must find their starts before any thread begins; run under the thread sanitizer
+ */
+#define SJTU_STATS 1
+#include <cassert>
+#include <cstdio>
+#include "../parallel.hpp"
+
+int main() {
+	sjtu::deque<int> d;
+	for(int i = 0; i < 100000; ++i) d.push_back(i % 1000);
+	const sjtu::deque<int> &cd = d;
+	long long expected = 0;
+	for(int i = 0; i < 100000; ++i) expected += i % 1000;
+	auto add = [](long long acc, int x) {return acc + x;};
+	auto combine = [](long long a, long long b) {return a + b;};
+	for(size_t threads = 1; threads <= 8; ++threads) assert(sjtu::parallel_reduce(cd, 0LL, add, combine, threads) == expected);
+	sjtu::parallel_for_each(d, [](int &x) {x *= 2;}, 4);
+	assert(sjtu::parallel_reduce(cd, 0LL, add, combine, 4) == 2 * expected);
+
+	sjtu::map<int, int> m;
+	for(int i = 0; i < 10000; ++i) m[i] = i;
+	const sjtu::map<int, int> &cm = m;
+	long long keys = sjtu::parallel_reduce(cm, 0LL, [](long long acc, const sjtu::pair<const int, int> &x) {return acc + x.first;},
+		combine, 4);
+	assert(keys == 10000LL * 9999 / 2);
+	puts("ok");
+	return 0;
+}
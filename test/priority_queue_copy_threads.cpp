@@ -0,0 +1,43 @@
+/**
+ * copying one const priority_queue on several threads at once, with a type that shares
+ * nodes between copies; the copies are destroyed while others are still being made, so a
+ * loan must outlive every copy as long as the queue lends it; run under the thread sanitizer
+ */
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "../priority_queue.hpp"
+
+struct key {
+	int x;
+	key(int _x = 0) : x(_x) {}
+	bool operator<(const key &rhs) const {return x < rhs.x;}
+};
+namespace sjtu {
+template<> struct share_on_copy<key> : std::true_type {};
+}
+
+int main() {
+	for(int round = 0; round < 20; ++round) {
+		sjtu::priority_queue<key, std::less<key>, sjtu::leftist_heap> source;
+		for(int i = 0; i < 1000; ++i) source.push(key(i * 37 % 1000));
+		const sjtu::priority_queue<key, std::less<key>, sjtu::leftist_heap> &shared = source;
+		std::vector<std::thread> threads;
+		std::vector<int> tops(8);
+		for(int t = 0; t < 8; ++t) threads.emplace_back([&shared, &tops, t]() {
+			for(int i = 0; i < 500; ++i) {
+				sjtu::priority_queue<key, std::less<key>, sjtu::leftist_heap> copy(shared);
+				if(copy.top().x != 999) return;
+			}
+			sjtu::priority_queue<key, std::less<key>, sjtu::leftist_heap> copy(shared);
+			tops[t] = copy.top().x;
+		});
+		for(size_t t = 0; t < threads.size(); ++t) threads[t].join();
+		for(int t = 0; t < 8; ++t) assert(tops[t] == 999);
+		source.pop();
+		assert(source.top().x == 998);
+	}
+	puts("ok");
+	return 0;
+}
@@ -0,0 +1,43 @@
+/**
+ * a copy of an unordered_map whose element copy throws partway leaves nothing behind:
+ * only the elements made so far are destroyed, and an assigned-to map is left empty
+ */
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include "../unordered_map.hpp"
+
+static int budget = -1, alive = 0;
+struct fragile {
+	std::string s;
+	fragile(const char *_s = "x") : s(_s) {++alive;}
+	// throws once budget copies were made, budget < 0 never throws
+	fragile(const fragile &o) : s(o.s) {
+		if(budget == 0) throw 1;
+		if(budget > 0) --budget;
+		++alive;
+	}
+	~fragile() {--alive;}
+};
+
+int main() {
+	sjtu::unordered_map<int, fragile> m;
+	for(int i = 0; i < 1000; ++i) m[i] = fragile("value");
+	for(int i = 0; i < 1000; i += 3) m.erase(m.find(i));
+	int before = alive;
+	for(int k = 0; k < 600; k += 37) {
+		budget = k;
+		bool thrown = false;
+		try {sjtu::unordered_map<int, fragile> c(m);} catch(int) {thrown = true;}
+		assert(thrown && alive == before);
+		sjtu::unordered_map<int, fragile> d;
+		d[5] = fragile("y");
+		try {d = m;} catch(int) {}
+		assert(alive == before + (int)d.size());
+	}
+	budget = -1;
+	sjtu::unordered_map<int, fragile> c(m);
+	assert(c.size() == m.size() && c.at(1).s == "value" && c.find(3) == c.end());
+	puts("ok");
+	return 0;
+}
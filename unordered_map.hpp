@@ -0,0 +1,401 @@
+#ifndef SJTU_UNORDERED_MAP_HPP
+#define SJTU_UNORDERED_MAP_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "stats.hpp"
+
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && !defined(SJTU_NO_SIMD)
+#define SJTU_HASH_SSE2 1
+#include <emmintrin.h>
+#else
+#define SJTU_HASH_SSE2 0
+#endif
+
+namespace sjtu {
+
+/**
+ * one control byte per slot: 0..127 for a full slot (seven bits of its hash),
+ * or empty/deleted/the sentinel that ends the table
+ * sixteen control bytes are matched at once, with SSE2 when available (SJTU_NO_SIMD turns it off)
+ */
+struct hash_group {
+	const static signed char EMPTY = -128;
+	const static signed char DELETED = -2;
+	const static signed char SENTINEL = -1;
+	const static size_t WIDTH = 16;
+#if SJTU_HASH_SSE2
+	__m128i ctrl;
+	explicit hash_group(const signed char *pos) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+	unsigned match(signed char h) const {return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h), ctrl));}
+	unsigned match_empty() const {return match(EMPTY);}
+	// empty or deleted, both sort below the sentinel
+	unsigned match_free() const {return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(SENTINEL), ctrl));}
+#else
+	const signed char *ctrl;
+	explicit hash_group(const signed char *pos) : ctrl(pos) {}
+	unsigned match(signed char h) const {
+		unsigned rtn = 0;
+		for(size_t i = 0; i < WIDTH; ++i) rtn |= (unsigned)(ctrl[i] == h) << i;
+		return rtn;
+	}
+	unsigned match_empty() const {return match(EMPTY);}
+	unsigned match_free() const {
+		unsigned rtn = 0;
+		for(size_t i = 0; i < WIDTH; ++i) rtn |= (unsigned)(ctrl[i] < SENTINEL) << i;
+		return rtn;
+	}
+#endif
+	static size_t lowest(unsigned mask) {
+#ifdef __GNUC__
+		return __builtin_ctz(mask);
+#else
+		size_t rtn = 0;
+		while(!(mask & 1)) mask >>= 1, ++rtn;
+		return rtn;
+#endif
+	}
+	static size_t highest(unsigned mask) {
+		size_t rtn = 0;
+		while(mask >>= 1) ++rtn;
+		return rtn;
+	}
+};
+
+/**
+ * open addressing over 2^k - 1 inline slots, probed one control group at a time;
+ * the table doubles (or is rebuilt in place when deleted slots pile up) once 7/8 is used
+ * insert and operator[] may rehash and invalidate every iterator; erase invalidates only its own
+ */
+template<class Key, class T, class Hash = std::hash<Key>, class Equal = std::equal_to<Key> >
+class unordered_map {
+public:
+	typedef pair<const Key, T> value_type;
+private:
+	typedef hash_group group;
+	typedef typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type slot;
+	const static size_t MIN_CAPACITY = 15;
+
+	signed char *ctrl;
+	slot *slots;
+	size_t capacity, current_size, growth_left;
+	Hash hasher;
+	Equal equal;
+
+	// what an empty table points to, so lookups need no special case
+	static signed char *empty_ctrl() {
+		static signed char rtn[group::WIDTH] = {group::SENTINEL, group::EMPTY, group::EMPTY, group::EMPTY,
+			group::EMPTY, group::EMPTY, group::EMPTY, group::EMPTY, group::EMPTY, group::EMPTY, group::EMPTY,
+			group::EMPTY, group::EMPTY, group::EMPTY, group::EMPTY, group::EMPTY};
+		return rtn;
+	}
+	static size_t max_load(size_t n) {return n - n / 8;}
+	// std::hash of an integer is often the integer itself, so spread it over every bit first
+	size_t hash(const Key &key) const {
+		unsigned long long x = (unsigned long long)hasher(key) * 0x9E3779B97F4A7C15ULL;
+		return (size_t)(x ^ (x >> 32));
+	}
+	static signed char h2(size_t h) {return (signed char)(h & 0x7F);}
+	value_type *at_slot(size_t i) const {return reinterpret_cast<value_type*>(slots + i);}
+	bool full(size_t i) const {return ctrl[i] >= 0;}
+	// the first WIDTH - 1 control bytes are mirrored after the sentinel for unaligned group loads
+	void set_ctrl(size_t i, signed char h) {
+		ctrl[i] = h;
+		ctrl[((i - (group::WIDTH - 1)) & capacity) + (group::WIDTH - 1)] = h;
+	}
+	void allocate(size_t n) {
+		capacity = n;
+		ctrl = new signed char[n + group::WIDTH];
+		std::memset(ctrl, group::EMPTY, n + group::WIDTH);
+		ctrl[n] = group::SENTINEL;
+		slots = static_cast<slot*>(::operator new(n * sizeof(slot)));
+		growth_left = max_load(n);
+	}
+	void release() {
+		if(capacity == 0) return;
+		delete [] ctrl;
+		::operator delete(slots);
+	}
+	void destroy() {
+		if(!std::is_trivially_destructible<value_type>::value)
+			for(size_t i = 0; i < capacity; ++i) if(full(i)) at_slot(i)->~value_type();
+		release();
+		ctrl = empty_ctrl();
+		slots = NULL;
+		capacity = current_size = growth_left = 0;
+	}
+	// index of key, or capacity when it is absent
+	size_t find_index(const Key &key) const {
+		if(capacity == 0) return 0;
+		size_t h = hash(key), offset = (h >> 7) & capacity;
+		for(size_t step = group::WIDTH; ; step += group::WIDTH) {
+			group now(ctrl + offset);
+			for(unsigned mask = now.match(h2(h)); mask; mask &= mask - 1) {
+				size_t i = (offset + group::lowest(mask)) & capacity;
+				if(equal(at_slot(i)->first, key)) return i;
+			}
+			if(now.match_empty()) return capacity;
+			offset = (offset + step) & capacity;
+		}
+	}
+	// the first empty or deleted slot on the probe sequence of h
+	size_t find_free(size_t h) const {
+		size_t offset = (h >> 7) & capacity;
+		for(size_t step = group::WIDTH; ; step += group::WIDTH) {
+			unsigned mask = group(ctrl + offset).match_free();
+			if(mask) return (offset + group::lowest(mask)) & capacity;
+			offset = (offset + step) & capacity;
+		}
+	}
+	// move every element into a fresh table of n slots, no element is copied
+	void rehash(size_t n) {
+		signed char *old_ctrl = ctrl;
+		slot *old_slots = slots;
+		size_t old_capacity = capacity;
+		allocate(n);
+		for(size_t i = 0; i < old_capacity; ++i) {
+			if(old_ctrl[i] < 0) continue;
+			value_type *from = reinterpret_cast<value_type*>(old_slots + i);
+			size_t h = hash(from->first), j = find_free(h);
+			if(is_trivially_relocatable<value_type>::value) {
+				std::memcpy(static_cast<void*>(slots + j), static_cast<const void*>(from), sizeof(slot));
+			} else {
+				new(slots + j) value_type(std::move(*from));
+				from->~value_type();
+			}
+			set_ctrl(j, h2(h));
+		}
+		growth_left -= current_size;
+		if(old_capacity == 0) return;
+		delete [] old_ctrl;
+		::operator delete(old_slots);
+	}
+	// a slot for a new element with hash h, growing first if no free slot may be used up
+	size_t prepare_insert(size_t h) {
+		size_t i = find_free(h);
+		if(growth_left == 0 && ctrl[i] != group::DELETED) {
+			if(capacity == 0) rehash(MIN_CAPACITY);
+			else if(current_size * 32 <= capacity * 25) rehash(capacity); // enough of the rest is deleted slots
+			else rehash(capacity * 2 + 1);
+			i = find_free(h);
+		}
+		if(ctrl[i] == group::EMPTY) --growth_left;
+		return i;
+	}
+	template<class... Args>
+	pair<size_t, bool> emplace(const Key &key, Args&&... args) {
+		size_t i = find_index(key);
+		if(i != capacity) return pair<size_t, bool>(i, false);
+		size_t h = hash(key);
+		i = prepare_insert(h);
+		new(slots + i) value_type(std::forward<Args>(args)...);
+		set_ctrl(i, h2(h));
+		++current_size;
+		return pair<size_t, bool>(i, true);
+	}
+	// a slot can go back to empty if no probe ever found its whole group full
+	void erase_index(size_t i) {
+		at_slot(i)->~value_type();
+		--current_size;
+		unsigned empty_after = group(ctrl + i).match_empty();
+		unsigned empty_before = group(ctrl + ((i - group::WIDTH) & capacity)).match_empty();
+		bool never_full = empty_before && empty_after &&
+			group::lowest(empty_after) + (group::WIDTH - 1 - group::highest(empty_before)) < group::WIDTH;
+		set_ctrl(i, never_full ? group::EMPTY : group::DELETED);
+		if(never_full) ++growth_left;
+	}
+	// a slot is marked full only once its element is made, so a throwing copy leaves only those to destroy
+	void copy(const unordered_map &other) {
+		if(other.capacity == 0) return;
+		allocate(other.capacity);
+		try {
+			for(size_t i = 0; i < capacity; ++i) if(other.full(i)) {
+				new(slots + i) value_type(*other.at_slot(i));
+				set_ctrl(i, other.ctrl[i]);
+			}
+		} catch(...) {
+			destroy();
+			throw;
+		}
+		std::memcpy(ctrl, other.ctrl, capacity + group::WIDTH);
+		current_size = other.current_size;
+		growth_left = other.growth_left;
+	}
+public:
+	class const_iterator;
+	class iterator {
+	private:
+		friend class unordered_map;
+		size_t index;
+		unordered_map *belong;
+	public:
+		iterator(size_t _index = 0, const unordered_map *_belong = NULL) :
+			index(_index), belong((unordered_map*)_belong) {}
+		iterator operator++(int) {
+			iterator rtn = *this;
+			operator++();
+			return rtn;
+		}
+		iterator & operator++() {
+			SJTU_THROW_IF(index >= belong->capacity, index_out_of_bound);
+			while(belong->ctrl[++index] < group::SENTINEL);
+			return *this;
+		}
+		iterator operator--(int) {
+			iterator rtn = *this;
+			operator--();
+			return rtn;
+		}
+		iterator & operator--() {
+			size_t i = index;
+			while(i > 0 && !belong->full(--i));
+			SJTU_THROW_IF(i == index || !belong->full(i), index_out_of_bound);
+			index = i;
+			return *this;
+		}
+		value_type & operator*() const {
+			SJTU_THROW_IF(belong == NULL || index >= belong->capacity || !belong->full(index), invalid_iterator);
+			return *belong->at_slot(index);
+		}
+		bool operator==(const iterator &rhs) const {return index == rhs.index && belong == rhs.belong;}
+		bool operator==(const const_iterator &rhs) const {return index == rhs.index && belong == rhs.belong;}
+		bool operator!=(const iterator &rhs) const {return !operator==(rhs);}
+		bool operator!=(const const_iterator &rhs) const {return !operator==(rhs);}
+		value_type* operator->() const noexcept {return belong->at_slot(index);}
+	};
+	class const_iterator {
+	private:
+		friend class unordered_map;
+		size_t index;
+		const unordered_map *belong;
+	public:
+		const_iterator(size_t _index = 0, const unordered_map *_belong = NULL) :
+			index(_index), belong(_belong) {}
+		const_iterator(const iterator &other) : index(other.index), belong(other.belong) {}
+		const_iterator operator++(int) {
+			const_iterator rtn = *this;
+			operator++();
+			return rtn;
+		}
+		const_iterator & operator++() {
+			SJTU_THROW_IF(index >= belong->capacity, index_out_of_bound);
+			while(belong->ctrl[++index] < group::SENTINEL);
+			return *this;
+		}
+		const_iterator operator--(int) {
+			const_iterator rtn = *this;
+			operator--();
+			return rtn;
+		}
+		const_iterator & operator--() {
+			size_t i = index;
+			while(i > 0 && !belong->full(--i));
+			SJTU_THROW_IF(i == index || !belong->full(i), index_out_of_bound);
+			index = i;
+			return *this;
+		}
+		const value_type & operator*() const {
+			SJTU_THROW_IF(belong == NULL || index >= belong->capacity || !belong->full(index), invalid_iterator);
+			return *belong->at_slot(index);
+		}
+		bool operator==(const iterator &rhs) const {return index == rhs.index && belong == rhs.belong;}
+		bool operator==(const const_iterator &rhs) const {return index == rhs.index && belong == rhs.belong;}
+		bool operator!=(const iterator &rhs) const {return !operator==(rhs);}
+		bool operator!=(const const_iterator &rhs) const {return !operator==(rhs);}
+		const value_type* operator->() const noexcept {return belong->at_slot(index);}
+	};
+	unordered_map() : ctrl(empty_ctrl()), slots(NULL), capacity(0), current_size(0), growth_left(0) {}
+	unordered_map(const unordered_map &other) : unordered_map() {copy(other);}
+	unordered_map(unordered_map &&other) : unordered_map() {
+		std::swap(ctrl, other.ctrl);
+		std::swap(slots, other.slots);
+		std::swap(capacity, other.capacity);
+		std::swap(current_size, other.current_size);
+		std::swap(growth_left, other.growth_left);
+	}
+	unordered_map &operator=(const unordered_map &other) {
+		if(this == &other) return *this;
+		destroy();
+		copy(other);
+		return *this;
+	}
+	~unordered_map() {destroy();}
+	T & at(const Key &key) {
+		size_t i = find_index(key);
+		if(i == capacity) throw index_out_of_bound();
+		return at_slot(i)->second;
+	}
+	const T & at(const Key &key) const {
+		size_t i = find_index(key);
+		if(i == capacity) throw index_out_of_bound();
+		return at_slot(i)->second;
+	}
+	T & operator[](const Key &key) {
+		size_t i = emplace(key, std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>()).first;
+		return at_slot(i)->second;
+	}
+	const T & operator[](const Key &key) const {return at(key);}
+	// NULL instead of index_out_of_bound
+	T * try_at(const Key &key) {
+		size_t i = find_index(key);
+		return i == capacity ? NULL : &at_slot(i)->second;
+	}
+	const T * try_at(const Key &key) const {
+		size_t i = find_index(key);
+		return i == capacity ? NULL : &at_slot(i)->second;
+	}
+	iterator begin() {
+		size_t i = 0;
+		while(ctrl[i] < group::SENTINEL) ++i;
+		return iterator(i, this);
+	}
+	const_iterator cbegin() const {
+		size_t i = 0;
+		while(ctrl[i] < group::SENTINEL) ++i;
+		return const_iterator(i, this);
+	}
+	iterator end() {return iterator(capacity, this);}
+	const_iterator cend() const {return const_iterator(capacity, this);}
+	bool empty() const {return current_size == 0;}
+	size_t size() const {return current_size;}
+	size_t bucket_count() const {return capacity;}
+	double load_factor() const {return capacity ? (double)current_size / capacity : 0;}
+	// room for n elements without another rehash
+	void reserve(size_t n) {
+		if(n <= current_size + growth_left) return;
+		size_t new_capacity = MIN_CAPACITY;
+		while(max_load(new_capacity) < n) new_capacity = new_capacity * 2 + 1;
+		rehash(new_capacity);
+	}
+	memory_footprint memory_usage() const {
+		size_t bytes = capacity ? (capacity + group::WIDTH) + capacity * sizeof(slot) : 0;
+		return memory_footprint(current_size, sizeof(value_type), 0, sizeof(unordered_map) + bytes);
+	}
+	void clear() {destroy();}
+	pair<iterator, bool> insert(const value_type &value) {
+		pair<size_t, bool> rtn = emplace(value.first, value);
+		return pair<iterator, bool>(iterator(rtn.first, this), rtn.second);
+	}
+	pair<iterator, bool> insert(value_type &&value) {
+		pair<size_t, bool> rtn = emplace(value.first, std::move(value));
+		return pair<iterator, bool>(iterator(rtn.first, this), rtn.second);
+	}
+	void erase(iterator pos) {
+		SJTU_THROW_IF(pos.belong != this || pos.index >= capacity || !full(pos.index), invalid_iterator);
+		erase_index(pos.index);
+	}
+	size_t count(const Key &key) const {return find_index(key) == capacity ? 0 : 1;}
+	iterator find(const Key &key) {return iterator(find_index(key), this);}
+	const_iterator find(const Key &key) const {return const_iterator(find_index(key), this);}
+};
+
+}
+
+#endif
@@ -1,27 +1,81 @@
 #ifndef SJTU_UTILITY_HPP
 #define SJTU_UTILITY_HPP
 
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 
+// a hint to start loading *p into the cache, it never faults, not even on NULL
+#ifdef __GNUC__
+#define SJTU_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define SJTU_PREFETCH(p) ((void)(p))
+#endif
+
 namespace sjtu {
 
+template<size_t... I> struct index_sequence {};
+template<size_t N, size_t... I> struct make_index_sequence : make_index_sequence<N - 1, N - 1, I...> {};
+template<size_t... I> struct make_index_sequence<0, I...> : index_sequence<I...> {};
+
+/**
+ * arguments are forwarded, so rvalues are moved into the members;
+ * copy and move are defaulted, a pair of trivially copyable types is trivially copyable
+ */
 template<class T1, class T2>
 class pair {
+	template<class... Args1, class... Args2, size_t... I1, size_t... I2>
+	pair(std::tuple<Args1...> &x, std::tuple<Args2...> &y, index_sequence<I1...>, index_sequence<I2...>) :
+		first(std::forward<Args1>(std::get<I1>(x))...), second(std::forward<Args2>(std::get<I2>(y))...) {}
 public:
 	T1 first;
 	T2 second;
 	constexpr pair() : first(), second() {}
 	pair(const pair &other) = default;
 	pair(pair &&other) = default;
-	pair(const T1 &x, const T2 &y) : first(x), second(y) {}
+	pair &operator=(const pair &other) = default;
+	pair &operator=(pair &&other) = default;
+	pair(const T1 &x, const T2 &y) noexcept(std::is_nothrow_copy_constructible<T1>::value &&
+		std::is_nothrow_copy_constructible<T2>::value) : first(x), second(y) {}
 	template<class U1, class U2>
-	pair(U1 &&x, U2 &&y) : first(x), second(y) {}
+	pair(U1 &&x, U2 &&y) noexcept(std::is_nothrow_constructible<T1, U1&&>::value &&
+		std::is_nothrow_constructible<T2, U2&&>::value) : first(std::forward<U1>(x)), second(std::forward<U2>(y)) {}
 	template<class U1, class U2>
-	pair(const pair<U1, U2> &other) : first(other.first), second(other.second) {}
+	pair(const pair<U1, U2> &other) noexcept(std::is_nothrow_constructible<T1, const U1&>::value &&
+		std::is_nothrow_constructible<T2, const U2&>::value) : first(other.first), second(other.second) {}
 	template<class U1, class U2>
-	pair(pair<U1, U2> &&other) : first(other.first), second(other.second) {}
+	pair(pair<U1, U2> &&other) noexcept(std::is_nothrow_constructible<T1, U1&&>::value &&
+		std::is_nothrow_constructible<T2, U2&&>::value) :
+		first(std::forward<U1>(other.first)), second(std::forward<U2>(other.second)) {}
+	// construct each member in place from the arguments packed in its tuple
+	template<class... Args1, class... Args2>
+	pair(std::piecewise_construct_t, std::tuple<Args1...> x, std::tuple<Args2...> y) :
+		pair(x, y, make_index_sequence<sizeof...(Args1)>(), make_index_sequence<sizeof...(Args2)>()) {}
 };
 
+/**
+ * types whose objects may be moved to another address by memcpy, the old bytes then dropped
+ * without running the destructor; specialize it for types that own memory but keep no self pointers
+ */
+template<class T> struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+template<class T1, class T2> struct is_trivially_relocatable<pair<T1, T2> > :
+	std::integral_constant<bool, is_trivially_relocatable<T1>::value && is_trivially_relocatable<T2>::value> {};
+
+/**
+ * whether copies of a container may share elements of this type until one of them changes them;
+ * off unless specialized: a shared copy never runs the copy constructor, and a reference, pointer
+ * or iterator taken into either container before the copy may afterwards point into the other one
+ * or dangle, so opt in only for types whose copies are costly, free of side effects, and whose
+ * elements are not held by reference across copies
+ */
+template<class T> struct share_on_copy : std::false_type {};
+
+template<class T1, class T2>
+pair<typename std::decay<T1>::type, typename std::decay<T2>::type> make_pair(T1 &&x, T2 &&y) {
+	return pair<typename std::decay<T1>::type, typename std::decay<T2>::type>(std::forward<T1>(x), std::forward<T2>(y));
+}
+
 }
 
 #endif
@@ -0,0 +1,315 @@
+#ifndef SJTU_VECTOR_HPP
+#define SJTU_VECTOR_HPP
+
+#include "exceptions.hpp"
+#include "stats.hpp"
+#include "utility.hpp"
+
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace sjtu {
+
+// room for N elements inside the vector object itself
+template<typename T, size_t N>
+struct vector_buffer {
+	typename std::aligned_storage<sizeof(T), alignof(T)>::type slots[N];
+	T *inline_data() {return reinterpret_cast<T*>(slots);}
+};
+template<typename T>
+struct vector_buffer<T, 0> {
+	T *inline_data() {return NULL;}
+};
+
+/**
+ * elements live in one array that grows geometrically;
+ * the first N elements fit in an inline buffer, so small vectors never touch the heap;
+ * trivially relocatable types are moved between buffers with memcpy/memmove,
+ * everything else is move-constructed and then destroyed, assignment is never used
+ */
+template<typename T, size_t N = 0>
+class vector : private vector_buffer<T, N> {
+	typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type slot;
+	T *data;
+	size_t current_size, current_capacity;
+
+	static T *allocate(size_t n) {return static_cast<T*>(::operator new(n * sizeof(T)));}
+	void release() {
+		if(data != this->inline_data()) ::operator delete(data);
+	}
+	// moves n elements from src to dest, the ranges may overlap, src is left raw
+	static void relocate(T *dest, T *src, size_t n) {
+		if(n == 0 || dest == src) return;
+		if(is_trivially_relocatable<T>::value) {
+			std::memmove(static_cast<void*>(dest), static_cast<const void*>(src), n * sizeof(T));
+		} else if(dest < src) {
+			for(size_t i = 0; i < n; ++i) new(dest + i) T(std::move(src[i])), src[i].~T();
+		} else {
+			for(size_t i = n; i-- > 0; ) new(dest + i) T(std::move(src[i])), src[i].~T();
+		}
+	}
+	static void copy_construct(T *dest, const T *src, size_t n) {
+		if(std::is_trivially_copyable<T>::value) {
+			if(n > 0) std::memcpy(static_cast<void*>(dest), static_cast<const void*>(src), n * sizeof(T));
+		} else for(size_t i = 0; i < n; ++i) new(dest + i) T(src[i]);
+	}
+	static void destroy(T *first, size_t n) {
+		if(!std::is_trivially_destructible<T>::value) for(size_t i = 0; i < n; ++i) first[i].~T();
+	}
+	size_t grown() const {
+		return current_capacity < 4 ? 4 : 2 * current_capacity;
+	}
+	void reallocate(size_t new_capacity) {
+		T *fresh = new_capacity <= N ? this->inline_data() : allocate(new_capacity);
+		if(fresh == data) return;
+		relocate(fresh, data, current_size);
+		release();
+		data = fresh;
+		current_capacity = new_capacity <= N ? N : new_capacity;
+	}
+	template<class... Args>
+	T *emplace_at(size_t index, Args&&... args) {
+		if(current_size == current_capacity) {
+			size_t new_capacity = grown();
+			T *fresh = allocate(new_capacity);
+			// build the new element first, args may refer into the old buffer
+			try {
+				new(fresh + index) T(std::forward<Args>(args)...);
+			} catch(...) {
+				::operator delete(fresh);
+				throw;
+			}
+			relocate(fresh, data, index);
+			relocate(fresh + index + 1, data + index, current_size - index);
+			release();
+			data = fresh;
+			current_capacity = new_capacity;
+		} else if(index == current_size) {
+			new(data + index) T(std::forward<Args>(args)...);
+		} else {
+			slot tmp;
+			T *value = new(&tmp) T(std::forward<Args>(args)...);
+			relocate(data + index + 1, data + index, current_size - index);
+			relocate(data + index, value, 1);
+		}
+		++current_size;
+		return data + index;
+	}
+	void remove_at(size_t index) {
+		data[index].~T();
+		relocate(data + index, data + index + 1, current_size - index - 1);
+		--current_size;
+	}
+	void steal(vector &other) {
+		if(other.data == other.inline_data()) {
+			relocate(data, other.data, other.current_size);
+		} else {
+			data = other.data;
+			current_capacity = other.current_capacity;
+			other.data = other.inline_data();
+			other.current_capacity = N;
+		}
+		current_size = other.current_size;
+		other.current_size = 0;
+	}
+public:
+	class const_iterator;
+	class iterator {
+		friend class vector;
+	private:
+		T *ptr;
+		vector *belong;
+	public:
+		iterator(T *_ptr = NULL, const vector *_belong = NULL) : ptr(_ptr), belong((vector*)_belong) {}
+		iterator operator+(const int &n) const {return iterator(ptr + n, belong);}
+		iterator operator-(const int &n) const {return iterator(ptr - n, belong);}
+		int operator-(const iterator &rhs) const {
+			SJTU_THROW_IF(belong != rhs.belong, invalid_iterator);
+			return ptr - rhs.ptr;
+		}
+		iterator operator+=(const int &n) {ptr += n; return *this;}
+		iterator operator-=(const int &n) {ptr -= n; return *this;}
+		iterator operator++(int) {return iterator(ptr++, belong);}
+		iterator& operator++() {++ptr; return *this;}
+		iterator operator--(int) {return iterator(ptr--, belong);}
+		iterator& operator--() {--ptr; return *this;}
+		T& operator*() const {
+			SJTU_THROW_IF(ptr < belong->data || ptr >= belong->data + belong->current_size, invalid_iterator);
+			return *ptr;
+		}
+		T* operator->() const noexcept {return ptr;}
+		bool operator==(const iterator &rhs) const {return ptr == rhs.ptr && belong == rhs.belong;}
+		bool operator==(const const_iterator &rhs) const {return ptr == rhs.ptr && belong == rhs.belong;}
+		bool operator!=(const iterator &rhs) const {return !operator==(rhs);}
+		bool operator!=(const const_iterator &rhs) const {return !operator==(rhs);}
+	};
+	class const_iterator {
+		friend class vector;
+	private:
+		const T *ptr;
+		const vector *belong;
+	public:
+		const_iterator(const T *_ptr = NULL, const vector *_belong = NULL) : ptr(_ptr), belong(_belong) {}
+		const_iterator(const iterator &other) : ptr(other.ptr), belong(other.belong) {}
+		const_iterator operator+(const int &n) const {return const_iterator(ptr + n, belong);}
+		const_iterator operator-(const int &n) const {return const_iterator(ptr - n, belong);}
+		int operator-(const const_iterator &rhs) const {
+			SJTU_THROW_IF(belong != rhs.belong, invalid_iterator);
+			return ptr - rhs.ptr;
+		}
+		const_iterator operator+=(const int &n) {ptr += n; return *this;}
+		const_iterator operator-=(const int &n) {ptr -= n; return *this;}
+		const_iterator operator++(int) {return const_iterator(ptr++, belong);}
+		const_iterator& operator++() {++ptr; return *this;}
+		const_iterator operator--(int) {return const_iterator(ptr--, belong);}
+		const_iterator& operator--() {--ptr; return *this;}
+		const T& operator*() const {
+			SJTU_THROW_IF(ptr < belong->data || ptr >= belong->data + belong->current_size, invalid_iterator);
+			return *ptr;
+		}
+		const T* operator->() const noexcept {return ptr;}
+		bool operator==(const iterator &rhs) const {return ptr == rhs.ptr && belong == rhs.belong;}
+		bool operator==(const const_iterator &rhs) const {return ptr == rhs.ptr && belong == rhs.belong;}
+		bool operator!=(const iterator &rhs) const {return !operator==(rhs);}
+		bool operator!=(const const_iterator &rhs) const {return !operator==(rhs);}
+	};
+	vector() : data(this->inline_data()), current_size(0), current_capacity(N) {}
+	vector(const vector &other) : vector() {
+		reserve(other.current_size);
+		copy_construct(data, other.data, other.current_size);
+		current_size = other.current_size;
+	}
+	vector(vector &&other) : vector() {steal(other);}
+	vector(size_t count, const T &value) : vector() {
+		reserve(count);
+		for(; current_size < count; ++current_size) new(data + current_size) T(value);
+	}
+	~vector() {
+		destroy(data, current_size);
+		release();
+	}
+	vector &operator=(const vector &other) {
+		if(this == &other) return *this;
+		clear();
+		reserve(other.current_size);
+		copy_construct(data, other.data, other.current_size);
+		current_size = other.current_size;
+		return *this;
+	}
+	vector &operator=(vector &&other) {
+		if(this == &other) return *this;
+		clear();
+		release();
+		data = this->inline_data();
+		current_capacity = N;
+		steal(other);
+		return *this;
+	}
+	T & at(const size_t &pos) {
+		if(pos >= current_size) throw index_out_of_bound();
+		return data[pos];
+	}
+	const T & at(const size_t &pos) const {
+		if(pos >= current_size) throw index_out_of_bound();
+		return data[pos];
+	}
+	T & operator[](const size_t &pos) {
+		SJTU_THROW_IF(pos >= current_size, index_out_of_bound);
+		return data[pos];
+	}
+	const T & operator[](const size_t &pos) const {
+		SJTU_THROW_IF(pos >= current_size, index_out_of_bound);
+		return data[pos];
+	}
+	// NULL instead of index_out_of_bound
+	T * try_at(const size_t &pos) {return pos < current_size ? data + pos : NULL;}
+	const T * try_at(const size_t &pos) const {return pos < current_size ? data + pos : NULL;}
+	T & front() {
+		if(empty()) throw container_is_empty();
+		return data[0];
+	}
+	const T & front() const {
+		if(empty()) throw container_is_empty();
+		return data[0];
+	}
+	T & back() {
+		if(empty()) throw container_is_empty();
+		return data[current_size - 1];
+	}
+	const T & back() const {
+		if(empty()) throw container_is_empty();
+		return data[current_size - 1];
+	}
+	iterator begin() {return iterator(data, this);}
+	const_iterator cbegin() const {return const_iterator(data, this);}
+	iterator end() {return iterator(data + current_size, this);}
+	const_iterator cend() const {return const_iterator(data + current_size, this);}
+	bool empty() const {return current_size == 0;}
+	size_t size() const {return current_size;}
+	size_t capacity() const {return current_capacity;}
+	// the inline buffer is part of sizeof(vector)
+	memory_footprint memory_usage() const {
+		size_t heap = current_capacity > N ? current_capacity * sizeof(T) : 0;
+		return memory_footprint(current_size, sizeof(T), 0, sizeof(vector) + heap);
+	}
+	size_t inline_capacity() const {return N;}
+	void reserve(size_t new_capacity) {
+		if(new_capacity > current_capacity) reallocate(new_capacity);
+	}
+	// back into the inline buffer if everything fits, else an exactly sized heap buffer
+	void shrink_to_fit() {
+		if(current_capacity == current_size || data == this->inline_data()) return;
+		if(current_size == 0 && N == 0) {
+			release();
+			data = NULL;
+			current_capacity = 0;
+		} else reallocate(current_size);
+	}
+	void clear() {
+		destroy(data, current_size);
+		current_size = 0;
+	}
+	iterator insert(iterator pos, const T &value) {
+		SJTU_THROW_IF(pos.belong != this || pos.ptr < data || pos.ptr > data + current_size, invalid_iterator);
+		return iterator(emplace_at(pos.ptr - data, value), this);
+	}
+	iterator insert(iterator pos, T &&value) {
+		SJTU_THROW_IF(pos.belong != this || pos.ptr < data || pos.ptr > data + current_size, invalid_iterator);
+		return iterator(emplace_at(pos.ptr - data, std::move(value)), this);
+	}
+	iterator insert(const size_t &ind, const T &value) {
+		if(ind > current_size) throw index_out_of_bound();
+		return iterator(emplace_at(ind, value), this);
+	}
+	iterator insert(const size_t &ind, T &&value) {
+		if(ind > current_size) throw index_out_of_bound();
+		return iterator(emplace_at(ind, std::move(value)), this);
+	}
+	iterator erase(iterator pos) {
+		SJTU_THROW_IF(pos.belong != this || pos.ptr < data || pos.ptr >= data + current_size, invalid_iterator);
+		size_t index = pos.ptr - data;
+		remove_at(index);
+		return iterator(data + index, this);
+	}
+	iterator erase(const size_t &ind) {
+		if(ind >= current_size) throw index_out_of_bound();
+		remove_at(ind);
+		return iterator(data + ind, this);
+	}
+	void push_back(const T &value) {emplace_at(current_size, value);}
+	void push_back(T &&value) {emplace_at(current_size, std::move(value));}
+	template<class... Args>
+	T & emplace_back(Args&&... args) {return *emplace_at(current_size, std::forward<Args>(args)...);}
+	void pop_back() {
+		if(empty()) throw container_is_empty();
+		data[--current_size].~T();
+	}
+};
+
+}
+
+#endif